@@ -0,0 +1,1009 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "archive.h"
+
+
+#define     ARCHIVE_SLOT_MARK       0x01    // template byte followed by the decimals of a number
+#define     ARCHIVE_ESCAPE          0x02    // template byte followed by a literal 0x01 or 0x02
+#define     ARCHIVE_MAX_DIGITS      18      // longer numbers stay literal text
+#define     ARCHIVE_KEY_MAX         65535   // a slot is a row key if all its values are addresses
+#define     ARCHIVE_NUMBER_SIZE     21      // "-" and 19 digits and "."
+
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} Archive_Buffer_t;
+
+/* last value and last step of a column per row key, open addressing on key + 1 */
+typedef struct {
+    uint32_t *key;
+    uint64_t *state;            // 2 per key
+    uint32_t mask;
+    uint32_t count;
+} Archive_Keys_t;
+
+/*
+ * how a column is predicted: value - base (a slot of the same row, the Tx time a receiver time follows) is predicted
+ * from its previous value on the same row key (an address, or a pair of them such as src and receiver), plus the
+ * previous step at order 2 for clocks that drift
+ */
+typedef struct {
+    int key;                    // slots, -1 for none
+    int key2;
+    int base;
+    int order;                  // 1 or 2
+} Archive_Predictor_t;
+
+typedef struct {
+    const uint8_t *bytes;       // literal text and slot marks
+    size_t length;
+    uint64_t hash;
+    int slots;
+    int timeSlot;               // slot of the indexed time, -1 if none
+    int rows;
+    uint8_t *decimals;
+    Archive_Predictor_t *predictor;
+    uint64_t *column;           // rows x slots values, column-major, two's complement
+    size_t *streamLength;
+    const uint8_t **stream;
+} Archive_Template_t;
+
+
+static void buffer_reserve(Archive_Buffer_t *buffer, size_t extra) {
+    if (buffer->length + extra > buffer->capacity) {
+        buffer->capacity = (buffer->length + extra) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+}
+
+static void buffer_put(Archive_Buffer_t *buffer, const void *data, size_t length) {
+    buffer_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void buffer_varint(Archive_Buffer_t *buffer, uint64_t value) {
+    buffer_reserve(buffer, 10);
+    while (value >= 0x80) {
+        buffer->data[buffer->length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->length++] = (uint8_t)value;
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static const uint8_t *varint_get(const uint8_t *p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ -(value & 1);
+}
+
+static void keys_reset(Archive_Keys_t *keys) {
+    if (keys->key == NULL) {
+        keys->mask = 15;
+        keys->key = malloc((keys->mask + 1) * sizeof(uint32_t));
+        keys->state = malloc((keys->mask + 1) * 2 * sizeof(uint64_t));
+    }
+    memset(keys->key, 0, (keys->mask + 1) * sizeof(uint32_t));
+    keys->count = 0;
+}
+
+static void keys_free(Archive_Keys_t *keys) {
+    free(keys->key);
+    free(keys->state);
+    memset(keys, 0, sizeof(Archive_Keys_t));
+}
+
+static uint64_t *keys_state(Archive_Keys_t *keys, uint32_t key) {
+    for (;;) {
+        uint32_t slot = (key * 2654435761u) & keys->mask;
+        for (; keys->key[slot] != 0; slot = (slot + 1) & keys->mask) {
+            if (keys->key[slot] == key + 1) {
+                return &keys->state[2 * slot];
+            }
+        }
+        if (2 * (keys->count + 1) <= keys->mask + 1) {
+            keys->key[slot] = key + 1;
+            keys->state[2 * slot] = 0;
+            keys->state[2 * slot + 1] = 0;
+            keys->count++;
+            return &keys->state[2 * slot];
+        }
+
+        // grow and rehash, then look the key up again
+        uint32_t *old_key = keys->key;
+        uint64_t *old_state = keys->state;
+        uint32_t old_size = keys->mask + 1;
+        keys->mask = old_size * 2 - 1;
+        keys->key = calloc(keys->mask + 1, sizeof(uint32_t));
+        keys->state = malloc((keys->mask + 1) * 2 * sizeof(uint64_t));
+        for (uint32_t i = 0; i < old_size; i++) {
+            if (old_key[i] != 0) {
+                uint32_t s = ((old_key[i] - 1) * 2654435761u) & keys->mask;
+                while (keys->key[s] != 0) {
+                    s = (s + 1) & keys->mask;
+                }
+                keys->key[s] = old_key[i];
+                keys->state[2 * s] = old_state[2 * i];
+                keys->state[2 * s + 1] = old_state[2 * i + 1];
+            }
+        }
+        free(old_key);
+        free(old_state);
+    }
+}
+
+/* state of the row key of row r, or the single state of a column without key */
+static uint64_t *predictor_state(const Archive_Template_t *t, const Archive_Predictor_t *p, int r, Archive_Keys_t *keys, uint64_t *single) {
+    if (p->key < 0) {
+        return single;
+    }
+    uint32_t key = (uint32_t)t->column[(size_t)p->key * t->rows + r];
+    if (p->key2 >= 0) {
+        key = key << 16 | (uint32_t)t->column[(size_t)p->key2 * t->rows + r];
+    }
+    return keys_state(keys, key);
+}
+
+static uint64_t predictor_residual(const Archive_Template_t *t, const Archive_Predictor_t *p, int slot, int r) {
+    uint64_t value = t->column[(size_t)slot * t->rows + r];
+    return p->base >= 0 ? value - t->column[(size_t)p->base * t->rows + r] : value;
+}
+
+static void predictor_advance(uint64_t *state, uint64_t residual) {
+    state[1] = residual - state[0];
+    state[0] = residual;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* -?digits(.digits)? at text, false if it would not print back identically; *run is its length either way */
+static bool parse_number(const char *text, size_t length, uint64_t *value, int *decimals, size_t *run) {
+    size_t i = text[0] == '-' ? 1 : 0;
+    size_t int_start = i;
+    while (i < length && is_digit(text[i])) {
+        i++;
+    }
+    size_t int_digits = i - int_start;
+    size_t frac_digits = 0;
+    if (i + 1 < length && text[i] == '.' && is_digit(text[i + 1])) {
+        size_t frac_start = ++i;
+        while (i < length && is_digit(text[i])) {
+            i++;
+        }
+        frac_digits = i - frac_start;
+    }
+    *run = i;
+
+    if (int_digits + frac_digits > ARCHIVE_MAX_DIGITS || (int_digits > 1 && text[int_start] == '0')) {
+        return false;
+    }
+    uint64_t mantissa = 0;
+    for (size_t j = int_start; j < i; j++) {
+        if (text[j] != '.') {
+            mantissa = mantissa * 10 + (uint64_t)(text[j] - '0');
+        }
+    }
+    if (text[0] == '-' && mantissa == 0) {
+        return false;
+    }
+    *value = text[0] == '-' ? -mantissa : mantissa;
+    *decimals = (int)frac_digits;
+    return true;
+}
+
+static char *put_number(char *p, uint64_t value, int decimals) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    bool negative = (int64_t)value < 0;
+    uint64_t magnitude = negative ? -value : value;
+    char digits[ARCHIVE_NUMBER_SIZE];
+    char *d = digits + sizeof(digits);
+    while (magnitude >= 100) {
+        d -= 2;
+        memcpy(d, &pairs[2 * (magnitude % 100)], 2);
+        magnitude /= 100;
+    }
+    if (magnitude >= 10) {
+        d -= 2;
+        memcpy(d, &pairs[2 * magnitude], 2);
+    }
+    else {
+        *--d = (char)('0' + magnitude);
+    }
+    int n = (int)(digits + sizeof(digits) - d);
+    while (n <= decimals) {
+        *--d = '0';
+        n++;
+    }
+
+    if (negative) {
+        *p++ = '-';
+    }
+    if (decimals == 0) {
+        memcpy(p, d, n);
+        return p + n;
+    }
+    memcpy(p, d, n - decimals);
+    p += n - decimals;
+    *p++ = '.';
+    memcpy(p, d + n - decimals, decimals);
+    return p + decimals;
+}
+
+static void put_literal(Archive_Buffer_t *buffer, char c) {
+    if (c == ARCHIVE_SLOT_MARK || c == ARCHIVE_ESCAPE) {
+        uint8_t escape = ARCHIVE_ESCAPE;
+        buffer_put(buffer, &escape, 1);
+    }
+    buffer_put(buffer, &c, 1);
+}
+
+/* the slot whose literal prefix ends with label, "" is a number at the start of the line (first CSV column) */
+static int template_time_slot(const uint8_t *bytes, size_t length, const char *label) {
+    size_t label_length = strlen(label);
+    int slot = 0;
+    for (size_t i = 0; i + 1 < length; i++) {
+        if (bytes[i] == ARCHIVE_ESCAPE) {
+            i++;
+            continue;
+        }
+        if (bytes[i] == ARCHIVE_SLOT_MARK) {
+            bool match = label_length == 0 ? i == 0 : i >= label_length && memcmp(bytes + i - label_length, label, label_length) == 0;
+            if (match && bytes[i + 1] == 0) {
+                return slot;
+            }
+            slot++;
+            i++;
+        }
+    }
+    return -1;
+}
+
+static uint64_t template_hash(const uint8_t *bytes, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* a run of zero deltas is a 0 followed by the run length - 1, any other delta its zigzag varint */
+static size_t run_cost(uint64_t delta, uint64_t *zeros) {
+    if (delta == 0) {
+        (*zeros)++;
+        return 0;
+    }
+    size_t cost = *zeros > 0 ? 1 + varint_size(*zeros - 1) : 0;
+    *zeros = 0;
+    return cost + varint_size(zigzag(delta));
+}
+
+static void run_put(Archive_Buffer_t *out, uint64_t delta, uint64_t *zeros) {
+    if (delta == 0) {
+        (*zeros)++;
+        return;
+    }
+    if (*zeros > 0) {
+        buffer_varint(out, 0);
+        buffer_varint(out, *zeros - 1);
+        *zeros = 0;
+    }
+    buffer_varint(out, zigzag(delta));
+}
+
+/* bytes of one column predicted with p at order 1 and at order 2, in one pass as both follow the same states */
+static void column_cost(const Archive_Template_t *t, int slot, const Archive_Predictor_t *p, Archive_Keys_t *keys, size_t cost[2]) {
+    uint64_t single[2] = {0, 0};
+    uint64_t zeros[2] = {0, 0};
+    cost[0] = cost[1] = 0;
+    keys_reset(keys);
+    for (int r = 0; r < t->rows; r++) {
+        uint64_t *state = predictor_state(t, p, r, keys, single);
+        uint64_t residual = predictor_residual(t, p, slot, r);
+        cost[0] += run_cost(residual - state[0], &zeros[0]);
+        cost[1] += run_cost(residual - state[0] - state[1], &zeros[1]);
+        predictor_advance(state, residual);
+    }
+    cost[0] += run_cost(1, &zeros[0]) - 1;
+    cost[1] += run_cost(1, &zeros[1]) - 1;
+}
+
+static void column_encode(const Archive_Template_t *t, int slot, Archive_Keys_t *keys, Archive_Buffer_t *out) {
+    const Archive_Predictor_t *p = &t->predictor[slot];
+    uint64_t single[2] = {0, 0};
+    uint64_t zeros = 0;
+    keys_reset(keys);
+    for (int r = 0; r < t->rows; r++) {
+        uint64_t *state = predictor_state(t, p, r, keys, single);
+        uint64_t residual = predictor_residual(t, p, slot, r);
+        uint64_t predicted = p->order == 2 ? state[0] + state[1] : state[0];
+        run_put(out, residual - predicted, &zeros);
+        predictor_advance(state, residual);
+    }
+    if (zeros > 0) {
+        buffer_varint(out, 0);
+        buffer_varint(out, zeros - 1);
+    }
+}
+
+/*
+ * keys are tried among the first slots of the row (src, seq) and the two addresses closest before the slot, alone or
+ * paired; bases among the first two wide slots of the same decimals and the closest one
+ */
+static void choose_predictors(Archive_Template_t *t, Archive_Keys_t *keys) {
+    bool *small = malloc(t->slots * sizeof(bool));
+    for (int s = 0; s < t->slots; s++) {
+        small[s] = t->decimals[s] == 0;
+        for (int r = 0; r < t->rows && small[s]; r++) {
+            small[s] = t->column[(size_t)s * t->rows + r] <= ARCHIVE_KEY_MAX;
+        }
+    }
+
+    for (int s = 0; s < t->slots; s++) {
+        int first[4], near[2];
+        int first_count = 0, near_count = 0;
+        for (int k = 0; k < s && k < 4; k++) {
+            if (small[k]) {
+                first[first_count++] = k;
+            }
+        }
+        for (int k = s - 1; k >= 4 && near_count < 2; k--) {
+            if (small[k]) {
+                near[near_count++] = k;
+            }
+        }
+        Archive_Predictor_t key[1 + 4 + 2 + 4 * 2];
+        int key_count = 0;
+        key[key_count++] = (Archive_Predictor_t){.key = -1, .key2 = -1};
+        for (int i = 0; i < first_count; i++) {
+            key[key_count++] = (Archive_Predictor_t){.key = first[i], .key2 = -1};
+        }
+        for (int j = 0; j < near_count; j++) {
+            key[key_count++] = (Archive_Predictor_t){.key = near[j], .key2 = -1};
+            for (int i = 0; i < first_count; i++) {
+                key[key_count++] = (Archive_Predictor_t){.key = first[i], .key2 = near[j]};
+            }
+        }
+
+        int base[3] = {-1};
+        int base_count = 1;
+        if (!small[s]) {
+            for (int k = 0; k < s && base_count < 3; k++) {
+                if (!small[k] && t->decimals[k] == t->decimals[s]) {
+                    base[base_count++] = k;
+                }
+            }
+            for (int k = s - 1; k >= 0; k--) {
+                if (!small[k] && t->decimals[k] == t->decimals[s]) {
+                    if (k != base[base_count - 1]) {
+                        base[base_count++] = k;
+                    }
+                    break;
+                }
+            }
+        }
+
+        size_t best = SIZE_MAX;
+        for (int b = 0; b < base_count; b++) {
+            for (int k = 0; k < key_count; k++) {
+                Archive_Predictor_t p = key[k];
+                size_t cost[2];
+                p.base = base[b];
+                column_cost(t, s, &p, keys, cost);
+                for (int order = 1; order <= 2; order++) {
+                    if (cost[order - 1] < best) {
+                        best = cost[order - 1];
+                        p.order = order;
+                        t->predictor[s] = p;
+                    }
+                }
+            }
+        }
+    }
+    free(small);
+}
+
+/* tokenize the pending lines into templates and columns, then write them as one block */
+static int writer_flush(Archive_Writer_t *writer) {
+    if (writer->lineCount == 0) {
+        return 0;
+    }
+
+    int line_count = writer->lineCount;
+    int *line_template = malloc(line_count * sizeof(int));
+    size_t *line_value = malloc((line_count + 1) * sizeof(size_t));
+    Archive_Buffer_t pool = {0}, line_bytes = {0}, values = {0};
+    Archive_Template_t *templates = NULL;
+    int template_count = 0, template_capacity = 0;
+    uint64_t first_time = UINT64_MAX, last_time = 0;
+
+    size_t start = 0;
+    for (int l = 0; l < line_count; l++) {
+        const char *text = writer->text + start;
+        size_t length = writer->lineEnd[l] - start;
+        line_bytes.length = 0;
+        line_value[l] = values.length / sizeof(uint64_t);
+
+        for (size_t i = 0; i < length; ) {
+            if (is_digit(text[i]) || (text[i] == '-' && i + 1 < length && is_digit(text[i + 1]))) {
+                uint64_t value;
+                int decimals;
+                size_t run;
+                if (parse_number(text + i, length - i, &value, &decimals, &run)) {
+                    uint8_t mark[2] = {ARCHIVE_SLOT_MARK, (uint8_t)decimals};
+                    buffer_put(&line_bytes, mark, 2);
+                    buffer_put(&values, &value, sizeof(value));
+                }
+                else {
+                    for (size_t j = 0; j < run; j++) {
+                        put_literal(&line_bytes, text[i + j]);
+                    }
+                }
+                i += run;
+            }
+            else {
+                put_literal(&line_bytes, text[i++]);
+            }
+        }
+        start = writer->lineEnd[l];
+
+        uint64_t hash = template_hash(line_bytes.data, line_bytes.length);
+        int t = 0;
+        while (t < template_count && (templates[t].hash != hash || templates[t].length != line_bytes.length
+               || memcmp(pool.data + (size_t)templates[t].bytes, line_bytes.data, line_bytes.length) != 0)) {
+            t++;
+        }
+        if (t == template_count) {
+            if (template_count == template_capacity) {
+                template_capacity = template_capacity ? template_capacity * 2 : 8;
+                templates = realloc(templates, template_capacity * sizeof(Archive_Template_t));
+            }
+            Archive_Template_t *added = &templates[template_count++];
+            memset(added, 0, sizeof(Archive_Template_t));
+            added->bytes = (const uint8_t *)pool.length;       // offset until the pool stops moving
+            added->length = line_bytes.length;
+            added->hash = hash;
+            added->slots = (int)(values.length / sizeof(uint64_t) - line_value[l]);
+            buffer_put(&pool, line_bytes.data, line_bytes.length);
+        }
+        templates[t].rows++;
+        line_template[l] = t;
+    }
+    line_value[line_count] = values.length / sizeof(uint64_t);
+    const uint64_t *value = (const uint64_t *)values.data;
+
+    // columns of every template, rows in line order
+    int *row = calloc(template_count, sizeof(int));
+    for (int t = 0; t < template_count; t++) {
+        Archive_Template_t *tp = &templates[t];
+        tp->bytes = pool.data + (size_t)tp->bytes;
+        tp->timeSlot = template_time_slot(tp->bytes, tp->length, writer->timeLabel);
+        tp->decimals = malloc(tp->slots + 1);
+        tp->predictor = malloc((tp->slots + 1) * sizeof(Archive_Predictor_t));
+        tp->column = malloc(((size_t)tp->slots * tp->rows + 1) * sizeof(uint64_t));
+        tp->streamLength = calloc(tp->slots + 1, sizeof(size_t));
+        for (size_t i = 0, s = 0; i + 1 < tp->length; i++) {
+            if (tp->bytes[i] == ARCHIVE_ESCAPE) {
+                i++;
+            }
+            else if (tp->bytes[i] == ARCHIVE_SLOT_MARK) {
+                tp->decimals[s++] = tp->bytes[++i];
+            }
+        }
+    }
+    for (int l = 0; l < line_count; l++) {
+        Archive_Template_t *tp = &templates[line_template[l]];
+        int r = row[line_template[l]]++;
+        for (int s = 0; s < tp->slots; s++) {
+            tp->column[(size_t)s * tp->rows + r] = value[line_value[l] + s];
+        }
+        if (tp->timeSlot >= 0) {
+            uint64_t time = value[line_value[l] + tp->timeSlot];
+            first_time = time < first_time ? time : first_time;
+            last_time = time > last_time ? time : last_time;
+        }
+    }
+
+    Archive_Keys_t keys = {0};
+    Archive_Buffer_t streams = {0}, block = {0};
+    for (int t = 0; t < template_count; t++) {
+        choose_predictors(&templates[t], &keys);
+        for (int s = 0; s < templates[t].slots; s++) {
+            size_t before = streams.length;
+            column_encode(&templates[t], s, &keys, &streams);
+            templates[t].streamLength[s] = streams.length - before;
+        }
+    }
+    keys_free(&keys);
+
+    buffer_varint(&block, line_count);
+    buffer_varint(&block, template_count);
+    for (int t = 0; t < template_count; t++) {
+        Archive_Template_t *tp = &templates[t];
+        buffer_varint(&block, tp->length);
+        buffer_put(&block, tp->bytes, tp->length);
+        buffer_varint(&block, (uint64_t)(tp->timeSlot + 1));
+        for (int s = 0; s < tp->slots; s++) {
+            buffer_varint(&block, (uint64_t)(tp->predictor[s].key + 1));
+            buffer_varint(&block, (uint64_t)(tp->predictor[s].key2 + 1));
+            buffer_varint(&block, (uint64_t)(tp->predictor[s].base + 1));
+            buffer_varint(&block, (uint64_t)tp->predictor[s].order);
+            buffer_varint(&block, tp->streamLength[s]);
+        }
+    }
+    if (template_count > 1) {
+        for (int l = 0; l < line_count; l++) {
+            buffer_varint(&block, line_template[l]);
+        }
+    }
+    buffer_put(&block, streams.data, streams.length);
+
+    if (writer->blockCount == writer->blockCapacity) {
+        writer->blockCapacity = writer->blockCapacity ? writer->blockCapacity * 2 : 64;
+        writer->block = realloc(writer->block, writer->blockCapacity * sizeof(Archive_Block_t));
+    }
+    writer->block[writer->blockCount++] = (Archive_Block_t){
+        .firstTime = first_time,
+        .lastTime = last_time,
+        .offset = (uint64_t)ftell(writer->fp),
+        .textOffset = writer->textOffset,
+        .firstLine = writer->lines,
+        .lineCount = (uint32_t)line_count,
+        .size = (uint32_t)block.length,
+        .textLength = (uint32_t)writer->textLength
+    };
+    int result = fwrite(block.data, 1, block.length, writer->fp) == block.length ? 0 : -1;
+    writer->textOffset += writer->textLength;
+    writer->lines += line_count;
+    writer->textLength = 0;
+    writer->lineCount = 0;
+
+    for (int t = 0; t < template_count; t++) {
+        free(templates[t].decimals);
+        free(templates[t].predictor);
+        free(templates[t].column);
+        free(templates[t].streamLength);
+    }
+    free(templates);
+    free(row);
+    free(line_template);
+    free(line_value);
+    free(pool.data);
+    free(line_bytes.data);
+    free(values.data);
+    free(streams.data);
+    free(block.data);
+    return result;
+}
+
+int archive_writer_open(Archive_Writer_t *writer, const char *filename, const char *timeLabel) {
+    memset(writer, 0, sizeof(Archive_Writer_t));
+    if (strlen(timeLabel) >= ARCHIVE_TIME_LABEL) {
+        fprintf(stderr, "Time label %s is longer than %d bytes\n", timeLabel, ARCHIVE_TIME_LABEL - 1);
+        return -1;
+    }
+    writer->fp = fopen(filename, "wb");
+    if (writer->fp == NULL) {
+        perror("Failed to open archive");
+        return -1;
+    }
+    snprintf(writer->timeLabel, sizeof(writer->timeLabel), "%s", timeLabel);
+    writer->lineEnd = malloc(ARCHIVE_BLOCK_LINES * sizeof(uint32_t));
+
+    Archive_Header_t header = {
+        .magic = ARCHIVE_MAGIC,
+        .version = ARCHIVE_VERSION,
+        .blockLines = ARCHIVE_BLOCK_LINES
+    };
+    memcpy(header.timeLabel, writer->timeLabel, sizeof(header.timeLabel));
+    fwrite(&header, sizeof(header), 1, writer->fp);
+    return 0;
+}
+
+/* one line of text, with its newline if it has one */
+int archive_writer_line(Archive_Writer_t *writer, const char *text, size_t length) {
+    if (writer->textLength + length > UINT32_MAX) {
+        fprintf(stderr, "Line of %zu bytes does not fit an archive block\n", length);
+        return -1;
+    }
+    if (writer->textLength + length > writer->textCapacity) {
+        writer->textCapacity = (writer->textLength + length) * 2;
+        writer->text = realloc(writer->text, writer->textCapacity);
+    }
+    memcpy(writer->text + writer->textLength, text, length);
+    writer->textLength += length;
+    writer->lineEnd[writer->lineCount++] = (uint32_t)writer->textLength;
+    return writer->lineCount == ARCHIVE_BLOCK_LINES ? writer_flush(writer) : 0;
+}
+
+int archive_writer_close(Archive_Writer_t *writer) {
+    int result = writer_flush(writer);
+
+    // the block index is 8-byte aligned so that readers can map it in place
+    long offset = ftell(writer->fp);
+    static const uint8_t zero[8] = {0};
+    fwrite(zero, 1, (8 - offset % 8) % 8, writer->fp);
+    Archive_Footer_t footer = {
+        .indexOffset = (uint64_t)((offset + 7) & ~7L),
+        .blockCount = (uint32_t)writer->blockCount,
+        .magic = ARCHIVE_INDEX_MAGIC
+    };
+    fwrite(writer->block, sizeof(Archive_Block_t), writer->blockCount, writer->fp);
+    fwrite(&footer, sizeof(footer), 1, writer->fp);
+    if (fclose(writer->fp) != 0 || result < 0) {
+        perror("Failed to write archive");
+        result = -1;
+    }
+
+    free(writer->text);
+    free(writer->lineEnd);
+    free(writer->block);
+    memset(writer, 0, sizeof(Archive_Writer_t));
+    return result;
+}
+
+bool archive_probe(const char *filename) {
+    char magic[4];
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    bool found = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return found;
+}
+
+int archive_open(Archive_Reader_t *reader, const char *filename) {
+    memset(reader, 0, sizeof(Archive_Reader_t));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open archive");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)(sizeof(Archive_Header_t) + sizeof(Archive_Footer_t))) {
+        fprintf(stderr, "Truncated archive %s\n", filename);
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map archive");
+        return -1;
+    }
+    reader->data = data;
+    reader->size = st.st_size;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    reader->header = data;
+    const Archive_Footer_t *footer = (const Archive_Footer_t *)(reader->data + reader->size - sizeof(Archive_Footer_t));
+    if (memcmp(reader->header->magic, ARCHIVE_MAGIC, 4) != 0 || reader->header->version != ARCHIVE_VERSION
+        || memcmp(footer->magic, ARCHIVE_INDEX_MAGIC, 4) != 0 || footer->indexOffset % 8 != 0 || footer->indexOffset < sizeof(Archive_Header_t)
+        || footer->indexOffset + (uint64_t)footer->blockCount * sizeof(Archive_Block_t) > reader->size - sizeof(Archive_Footer_t)) {
+        fprintf(stderr, "Invalid archive %s\n", filename);
+        archive_close(reader);
+        return -1;
+    }
+    reader->block = (const Archive_Block_t *)(reader->data + footer->indexOffset);
+    reader->blockCount = (int)footer->blockCount;
+    for (int i = 0; i < reader->blockCount; i++) {
+        if (reader->block[i].offset + reader->block[i].size > footer->indexOffset) {
+            fprintf(stderr, "Invalid block %d of archive %s\n", i, filename);
+            archive_close(reader);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void archive_close(Archive_Reader_t *reader) {
+    if (reader->data != NULL) {
+        munmap(reader->data, reader->size);
+    }
+    memset(reader, 0, sizeof(Archive_Reader_t));
+}
+
+/* first block holding a line at or after systemTime, blockCount if none; blocks are in time order for sorted files */
+int archive_lower_bound(const Archive_Reader_t *reader, uint64_t systemTime) {
+    for (int i = 0; i < reader->blockCount; i++) {
+        const Archive_Block_t *block = &reader->block[i];
+        if (block->firstTime <= block->lastTime && block->lastTime >= systemTime) {
+            return i;
+        }
+    }
+    return reader->blockCount;
+}
+
+/*
+ * text of a block, block->textLength bytes; lineTime and timed (lineCount entries each) receive the indexed time of
+ * every line when not NULL
+ */
+int archive_decode(const Archive_Reader_t *reader, int index, char *text, uint64_t *lineTime, bool *timed) {
+    const Archive_Block_t *block = &reader->block[index];
+    const uint8_t *p = reader->data + block->offset;
+    const uint8_t *end = p + block->size;
+    uint64_t line_count, template_count, v;
+    if ((p = varint_get(p, end, &line_count)) == NULL || line_count != block->lineCount
+        || (p = varint_get(p, end, &template_count)) == NULL || template_count == 0 || template_count > line_count) {
+        return -1;
+    }
+
+    int result = -1;
+    Archive_Template_t *templates = calloc(template_count, sizeof(Archive_Template_t));
+    uint32_t *line_template = calloc(line_count, sizeof(uint32_t));
+    for (uint64_t t = 0; t < template_count; t++) {
+        Archive_Template_t *tp = &templates[t];
+        if ((p = varint_get(p, end, &v)) == NULL || v > (uint64_t)(end - p)) {
+            goto done;
+        }
+        tp->bytes = p;
+        tp->length = v;
+        p += v;
+        for (size_t i = 0; i + 1 < tp->length; i++) {
+            if (tp->bytes[i] == ARCHIVE_ESCAPE) {
+                i++;
+            }
+            else if (tp->bytes[i] == ARCHIVE_SLOT_MARK) {
+                tp->slots++;
+                i++;
+            }
+        }
+        if ((p = varint_get(p, end, &v)) == NULL || v > (uint64_t)tp->slots) {
+            goto done;
+        }
+        tp->timeSlot = (int)v - 1;
+        tp->predictor = malloc((tp->slots + 1) * sizeof(Archive_Predictor_t));
+        tp->streamLength = malloc((tp->slots + 1) * sizeof(size_t));
+        tp->stream = malloc((tp->slots + 1) * sizeof(uint8_t *));
+        for (int s = 0; s < tp->slots; s++) {
+            uint64_t field[5];
+            for (int f = 0; f < 5; f++) {
+                if ((p = varint_get(p, end, &field[f])) == NULL || (f < 3 && field[f] > (uint64_t)s)) {
+                    goto done;
+                }
+            }
+            if (field[3] < 1 || field[3] > 2 || (field[0] == 0 && field[1] != 0)) {
+                goto done;
+            }
+            tp->predictor[s] = (Archive_Predictor_t){
+                .key = (int)field[0] - 1,
+                .key2 = (int)field[1] - 1,
+                .base = (int)field[2] - 1,
+                .order = (int)field[3]
+            };
+            tp->streamLength[s] = field[4];
+        }
+    }
+    for (uint64_t l = 0; l < line_count; l++) {
+        if (template_count > 1 && ((p = varint_get(p, end, &v)) == NULL || v >= template_count)) {
+            goto done;
+        }
+        line_template[l] = template_count > 1 ? (uint32_t)v : 0;
+        templates[line_template[l]].rows++;
+    }
+    for (uint64_t t = 0; t < template_count; t++) {
+        for (int s = 0; s < templates[t].slots; s++) {
+            if (templates[t].streamLength[s] > (size_t)(end - p)) {
+                goto done;
+            }
+            templates[t].stream[s] = p;
+            p += templates[t].streamLength[s];
+        }
+    }
+
+    // columns in slot order, key and base slots are always decoded before the slots they predict
+    Archive_Keys_t keys = {0};
+    for (uint64_t t = 0; t < template_count; t++) {
+        Archive_Template_t *tp = &templates[t];
+        tp->column = malloc(((size_t)tp->slots * tp->rows + 1) * sizeof(uint64_t));
+        for (int s = 0; s < tp->slots; s++) {
+            const Archive_Predictor_t *predictor = &tp->predictor[s];
+            uint64_t *value = &tp->column[(size_t)s * tp->rows];
+            const uint64_t *base = predictor->base >= 0 ? &tp->column[(size_t)predictor->base * tp->rows] : NULL;
+            const uint8_t *q = tp->stream[s], *stream_end = q + tp->streamLength[s];
+            uint64_t single[2] = {0, 0};
+            uint64_t zeros = 0;
+            keys_reset(&keys);
+            for (int r = 0; r < tp->rows; r++) {
+                uint64_t delta = 0;
+                if (zeros > 0) {
+                    zeros--;
+                }
+                else if ((q = varint_get(q, stream_end, &v)) == NULL || (v == 0 && (q = varint_get(q, stream_end, &zeros)) == NULL)) {
+                    keys_free(&keys);
+                    goto done;
+                }
+                else {
+                    delta = unzigzag(v);
+                }
+                uint64_t *state = predictor_state(tp, predictor, r, &keys, single);
+                uint64_t residual = (predictor->order == 2 ? state[0] + state[1] : state[0]) + delta;
+                predictor_advance(state, residual);
+                value[r] = base != NULL ? residual + base[r] : residual;
+            }
+        }
+    }
+    keys_free(&keys);
+
+    // render the lines, every number goes back with the decimals it was read with
+    char *out = text, *text_end = text + block->textLength;
+    int *row = calloc(template_count, sizeof(int));
+    for (uint64_t l = 0; l < line_count; l++) {
+        Archive_Template_t *tp = &templates[line_template[l]];
+        int r = row[line_template[l]]++;
+        int s = 0;
+        for (size_t i = 0; i < tp->length; i++) {
+            uint8_t c = tp->bytes[i];
+            if (c == ARCHIVE_SLOT_MARK && i + 1 < tp->length) {
+                int decimals = tp->bytes[++i];
+                char number[ARCHIVE_NUMBER_SIZE];
+                char *number_end = decimals <= ARCHIVE_MAX_DIGITS ? put_number(number, tp->column[(size_t)s++ * tp->rows + r], decimals) : NULL;
+                if (number_end == NULL || number_end - number > text_end - out) {
+                    free(row);
+                    goto done;
+                }
+                memcpy(out, number, number_end - number);
+                out += number_end - number;
+                continue;
+            }
+            if (c == ARCHIVE_ESCAPE && i + 1 < tp->length) {
+                c = tp->bytes[++i];
+            }
+            if (out == text_end) {
+                free(row);
+                goto done;
+            }
+            *out++ = (char)c;
+        }
+        if (lineTime != NULL) {
+            timed[l] = tp->timeSlot >= 0;
+            lineTime[l] = timed[l] ? tp->column[(size_t)tp->timeSlot * tp->rows + r] : 0;
+        }
+    }
+    free(row);
+    result = out == text_end ? 0 : -1;
+
+done:
+    for (uint64_t t = 0; t < template_count; t++) {
+        free(templates[t].predictor);
+        free(templates[t].streamLength);
+        free(templates[t].stream);
+        free(templates[t].column);
+    }
+    free(templates);
+    free(line_template);
+    return result;
+}
+
+/* decoded text read through stdio, seekable to any offset of the text */
+typedef struct {
+    Archive_Reader_t reader;
+    char *text;                 // decoded block
+    size_t length;
+    size_t position;            // read position in the block
+    int block;                  // decoded block, -1 before the first read
+} Archive_Stream_t;
+
+static int stream_load(Archive_Stream_t *stream, int block) {
+    size_t length = stream->reader.block[block].textLength;
+    if (length > stream->length || stream->text == NULL) {
+        free(stream->text);
+        stream->text = malloc(length + 1);
+    }
+    if (archive_decode(&stream->reader, block, stream->text, NULL, NULL) < 0) {
+        fprintf(stderr, "Corrupt block %d of archive\n", block);
+        return -1;
+    }
+    stream->block = block;
+    stream->length = length;
+    stream->position = 0;
+    return 0;
+}
+
+static ssize_t stream_read(void *cookie, char *buffer, size_t size) {
+    Archive_Stream_t *stream = cookie;
+    while (stream->position == stream->length) {
+        if (stream->block + 1 >= stream->reader.blockCount) {
+            return 0;
+        }
+        if (stream_load(stream, stream->block + 1) < 0) {
+            return -1;
+        }
+    }
+    size_t length = stream->length - stream->position < size ? stream->length - stream->position : size;
+    memcpy(buffer, stream->text + stream->position, length);
+    stream->position += length;
+    return (ssize_t)length;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+    Archive_Stream_t *stream = cookie;
+    const Archive_Reader_t *reader = &stream->reader;
+    uint64_t total = reader->blockCount > 0 ? reader->block[reader->blockCount - 1].textOffset + reader->block[reader->blockCount - 1].textLength : 0;
+    uint64_t current = stream->block >= 0 ? reader->block[stream->block].textOffset + stream->position : 0;
+    int64_t target = whence == SEEK_SET ? *offset : whence == SEEK_CUR ? (int64_t)current + *offset : (int64_t)total + *offset;
+    if (target < 0 || (uint64_t)target > total) {
+        return -1;
+    }
+    if ((uint64_t)target != current) {
+        int lo = 0, hi = reader->blockCount - 1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo + 1) / 2;
+            if (reader->block[mid].textOffset <= (uint64_t)target) {
+                lo = mid;
+            }
+            else {
+                hi = mid - 1;
+            }
+        }
+        if (lo != stream->block && stream_load(stream, lo) < 0) {
+            return -1;
+        }
+        stream->position = (size_t)((uint64_t)target - reader->block[lo].textOffset);
+    }
+    *offset = target;
+    return 0;
+}
+
+static int stream_close(void *cookie) {
+    Archive_Stream_t *stream = cookie;
+    free(stream->text);
+    archive_close(&stream->reader);
+    free(stream);
+    return 0;
+}
+
+FILE *archive_fopen(const char *filename) {
+    Archive_Stream_t *stream = calloc(1, sizeof(Archive_Stream_t));
+    if (archive_open(&stream->reader, filename) < 0) {
+        free(stream);
+        return NULL;
+    }
+    stream->block = -1;
+    cookie_io_functions_t functions = {
+        .read = stream_read,
+        .write = NULL,
+        .seek = stream_seek,
+        .close = stream_close
+    };
+    FILE *fp = fopencookie(stream, "r", functions);
+    if (fp == NULL) {
+        stream_close(stream);
+    }
+    return fp;
+}
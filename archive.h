@@ -0,0 +1,83 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+
+#include "support.h"
+#include <sys/types.h>
+
+
+#define     ARCHIVE_MAGIC           "DAR1"
+#define     ARCHIVE_INDEX_MAGIC     "DARI"
+#define     ARCHIVE_VERSION         1
+#define     ARCHIVE_BLOCK_LINES     4096    // lines per independently decodable block
+#define     ARCHIVE_TIME_LABEL      16      // bytes of the label in front of the indexed time, "" is the first CSV column
+
+
+/*
+ * Text files of numbers (traces, sniffer captures, distance logs, vicon.txt) compressed losslessly: every line is
+ * split into a template of its literal text and the numbers in it. Within a block, the numbers of one template slot
+ * form a column stored as zigzag varints of the delta to the previous value of the column on the same row key (an
+ * address or a src/receiver pair in earlier slots), after subtracting a base slot of the row (the Tx time a receiver
+ * time follows) and optionally the previous step, so that each 40-bit clock is predicted from its own drift; runs of
+ * zero deltas take two bytes. Blocks are indexed by the time of their lines.
+ */
+typedef struct {
+    char magic[4];              // ARCHIVE_MAGIC
+    uint32_t version;
+    uint32_t blockLines;
+    char timeLabel[ARCHIVE_TIME_LABEL];     // text preceding the indexed number of a line
+    uint32_t reserved;
+} Archive_Header_t;
+
+typedef struct {
+    uint64_t firstTime;         // smallest and largest time of the lines of the block, firstTime > lastTime if none
+    uint64_t lastTime;
+    uint64_t offset;            // file offset of the encoded block
+    uint64_t textOffset;        // offset of the block in the decoded text
+    uint64_t firstLine;
+    uint32_t lineCount;
+    uint32_t size;              // encoded bytes
+    uint32_t textLength;        // decoded bytes
+    uint32_t reserved;
+} Archive_Block_t;
+
+typedef struct {
+    uint64_t indexOffset;       // file offset of Archive_Block_t[blockCount]
+    uint32_t blockCount;
+    char magic[4];              // ARCHIVE_INDEX_MAGIC
+} Archive_Footer_t;             // last bytes of the file
+
+typedef struct {
+    uint8_t *data;              // whole file, mapped read-only
+    size_t size;
+    const Archive_Header_t *header;
+    const Archive_Block_t *block;
+    int blockCount;
+} Archive_Reader_t;
+
+typedef struct {
+    FILE *fp;
+    char timeLabel[ARCHIVE_TIME_LABEL];
+    char *text;                 // lines of the pending block
+    size_t textLength;
+    size_t textCapacity;
+    uint32_t *lineEnd;          // end of every pending line in text
+    int lineCount;
+    uint64_t textOffset;
+    uint64_t lines;
+    Archive_Block_t *block;
+    int blockCount;
+    int blockCapacity;
+} Archive_Writer_t;
+
+
+bool archive_probe(const char *filename);
+int archive_open(Archive_Reader_t *reader, const char *filename);
+void archive_close(Archive_Reader_t *reader);
+int archive_lower_bound(const Archive_Reader_t *reader, uint64_t systemTime);
+int archive_decode(const Archive_Reader_t *reader, int block, char *text, uint64_t *lineTime, bool *timed);
+FILE *archive_fopen(const char *filename);
+int archive_writer_open(Archive_Writer_t *writer, const char *filename, const char *timeLabel);
+int archive_writer_line(Archive_Writer_t *writer, const char *text, size_t length);
+int archive_writer_close(Archive_Writer_t *writer);
+#endif
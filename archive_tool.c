@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <sys/stat.h>
+#include "archive.h"
+
+
+static void usage() {
+    printf("Usage: ./archive pack [-o output.dar] [-k time_label] file\n"
+           "       ./archive cat [-f from] [-t to] file.dar\n"
+           "       ./archive info file.dar\n");
+}
+
+/* traces and captures are indexed on their first column, distance logs on sys_time, vicon.txt on time */
+static const char *detect_label(FILE *fp) {
+    const char *label = "time = ";
+    char *text = NULL;
+    size_t text_size = 0;
+    for (int i = 0; i < 64 && getline(&text, &text_size, fp) > 0; i++) {
+        if (i == 0 && strncmp(text, "system_time,", strlen("system_time,")) == 0) {
+            label = "";
+            break;
+        }
+        if (strstr(text, "sys_time = ") != NULL) {
+            label = "sys_time = ";
+            break;
+        }
+    }
+    free(text);
+    rewind(fp);
+    return label;
+}
+
+static int pack(const char *filename, const char *output_name, const char *label) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Failed to open file");
+        return -1;
+    }
+    if (label == NULL) {
+        label = detect_label(fp);
+    }
+    char default_name[strlen(filename) + sizeof(".dar")];
+    snprintf(default_name, sizeof(default_name), "%s.dar", filename);
+
+    Archive_Writer_t writer;
+    if (archive_writer_open(&writer, output_name ? output_name : default_name, label) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    char *text = NULL;
+    size_t text_size = 0;
+    ssize_t length;
+    int result = 0;
+    uint64_t bytes = 0;
+    while (result == 0 && (length = getline(&text, &text_size, fp)) > 0) {
+        result = archive_writer_line(&writer, text, (size_t)length);
+        bytes += (uint64_t)length;
+    }
+    if (archive_writer_close(&writer) < 0) {
+        result = -1;
+    }
+    free(text);
+    fclose(fp);
+
+    if (result == 0) {
+        struct stat st;
+        if (stat(output_name ? output_name : default_name, &st) == 0) {
+            printf("%s: %lu bytes -> %lu bytes (%.1fx), time label \"%s\"\n", filename, bytes, (uint64_t)st.st_size,
+                   st.st_size > 0 ? (double)bytes / st.st_size : 0.0, label);
+        }
+    }
+    return result;
+}
+
+/* the whole text, or the lines timed within [from, to] and the untimed lines leading the file (a CSV header) */
+static int cat(const char *filename, uint64_t from, uint64_t to) {
+    Archive_Reader_t reader;
+    if (archive_open(&reader, filename) < 0) {
+        return -1;
+    }
+    bool ranged = from > 0 || to > 0;
+    size_t capacity = 0;
+    char *text = NULL;
+    uint64_t *line_time = NULL;
+    bool *timed = NULL;
+    if (ranged) {
+        line_time = malloc(reader.header->blockLines * sizeof(uint64_t));
+        timed = malloc(reader.header->blockLines * sizeof(bool));
+    }
+
+    int result = 0;
+    for (int b = 0; b < reader.blockCount && result == 0; b++) {
+        const Archive_Block_t *block = &reader.block[b];
+        bool leading = b == 0;
+        if (ranged && !leading && (block->firstTime > block->lastTime || block->lastTime < from || (to > 0 && block->firstTime > to))) {
+            continue;
+        }
+        if (block->lineCount > reader.header->blockLines) {
+            result = -1;
+            break;
+        }
+        if (block->textLength > capacity) {
+            capacity = block->textLength;
+            free(text);
+            text = malloc(capacity);
+        }
+        if (archive_decode(&reader, b, text, line_time, timed) < 0) {
+            fprintf(stderr, "Corrupt block %d of %s\n", b, filename);
+            result = -1;
+            break;
+        }
+        if (!ranged) {
+            fwrite(text, 1, block->textLength, stdout);
+            continue;
+        }
+
+        char *line = text;
+        for (uint32_t l = 0; l < block->lineCount; l++) {
+            char *end = memchr(line, '\n', text + block->textLength - line);
+            end = end ? end + 1 : text + block->textLength;
+            leading = leading && !timed[l];
+            if (leading || (timed[l] && line_time[l] >= from && (to == 0 || line_time[l] <= to))) {
+                fwrite(line, 1, end - line, stdout);
+            }
+            line = end;
+        }
+    }
+
+    free(text);
+    free(line_time);
+    free(timed);
+    archive_close(&reader);
+    return result;
+}
+
+static int info(const char *filename) {
+    Archive_Reader_t reader;
+    if (archive_open(&reader, filename) < 0) {
+        return -1;
+    }
+    uint64_t lines = 0, text_bytes = 0;
+    uint64_t first_time = UINT64_MAX, last_time = 0;
+    for (int b = 0; b < reader.blockCount; b++) {
+        const Archive_Block_t *block = &reader.block[b];
+        lines += block->lineCount;
+        text_bytes += block->textLength;
+        if (block->firstTime <= block->lastTime) {
+            first_time = block->firstTime < first_time ? block->firstTime : first_time;
+            last_time = block->lastTime > last_time ? block->lastTime : last_time;
+        }
+    }
+    printf("%s: %d blocks, %lu lines, %lu bytes of text in %lu bytes (%.1fx)\n", filename, reader.blockCount, lines, text_bytes,
+           (uint64_t)reader.size, reader.size > 0 ? (double)text_bytes / reader.size : 0.0);
+    if (first_time <= last_time) {
+        printf("time label \"%s\": %lu to %lu\n", reader.header->timeLabel, first_time, last_time);
+    }
+    archive_close(&reader);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    const char *command = argv[1];
+    const char *output_name = NULL;
+    const char *label = NULL;
+    uint64_t from = 0, to = 0;
+
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "o:k:f:t:h")) != -1) {
+        switch (opt) {
+            case 'o': output_name = optarg; break;
+            case 'k': label = optarg; break;
+            case 'f': from = strtoull(optarg, NULL, 10); break;
+            case 't': to = strtoull(optarg, NULL, 10); break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+        return 1;
+    }
+
+    int result;
+    if (strcmp(command, "pack") == 0) {
+        result = pack(argv[optind], output_name, label);
+    }
+    else if (strcmp(command, "cat") == 0) {
+        result = cat(argv[optind], from, to);
+    }
+    else if (strcmp(command, "info") == 0) {
+        result = info(argv[optind]);
+    }
+    else {
+        usage();
+        return 1;
+    }
+    return result < 0 ? 1 : 0;
+}
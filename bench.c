@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include "node.h"
+
+
+#define     BENCH_PERIOD_MS         20      // ms between two rounds of messages, a typical ranging period
+#define     BENCH_TICKS_PER_MS      ((uint64_t)(0.001 / DWT_TIME_UNITS))
+#define     BENCH_CLOCK_OFFSET      0x1234567890ULL     // clocks of two drones differ by this many ticks
+
+
+extern dwTime_t TxTimestamp;
+extern dwTime_t RxTimestamp;
+
+
+typedef struct {
+    double mean;                    // ns per node_rx
+    uint64_t median;
+    uint64_t p99;
+} Bench_Result_t;
+
+
+static void usage() {
+    printf("Usage: ./bench [-n max_neighbors] [-m messages] [-l packet_loss]\n");
+}
+
+/* timestamp of drone i at ms since the start of the bench, never 0 */
+static uint64_t bench_clock(int i, uint64_t ms) {
+    uint64_t timestamp = (i * BENCH_CLOCK_OFFSET + ms * BENCH_TICKS_PER_MS) % UWB_MAX_TIMESTAMP;
+    return timestamp != 0 ? timestamp : 1;
+}
+
+static int compare_sample(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* drone 1 hears every message of drones 2 .. neighbors + 1 in rounds, as in a dense trace; only node_rx is timed */
+static Bench_Result_t bench_run(int neighbors, int messages, uint64_t *sample) {
+    int count = neighbors + 1;
+    Drone_Context_t *context = malloc(count * sizeof(Drone_Context_t));
+    for (int i = 0; i < count; i++) {
+        char name[ADDR_SIZE];
+        snprintf(name, sizeof(name), "%d", i + 1);
+        context_init(&context[i], name);
+    }
+
+    Ranging_Message_t ranging_msg;
+    int measured = 0;
+    for (uint64_t round = 0; measured < messages; round++) {
+        // the receiver ranges too, its own Tx is part of the state its Rx callbacks work on
+        uint64_t round_ms = round * BENCH_PERIOD_MS;
+        context_switch(&context[0]);
+        TxTimestamp.full = bench_clock(0, round_ms);
+        node_tx(&context[0], TxTimestamp, &ranging_msg);
+
+        for (int j = 1; j < count && measured < messages; j++) {
+            uint64_t send_ms = round_ms + j * BENCH_PERIOD_MS / count;
+            context_switch(&context[j]);
+            TxTimestamp.full = bench_clock(j, send_ms);
+            node_tx(&context[j], TxTimestamp, &ranging_msg);
+            ranging_msg.header.srcAddress = context[j].id;
+
+            // same order as replay_run: switch to the receiver, then hand it the Rx timestamp
+            context_switch(&context[0]);
+            RxTimestamp.full = bench_clock(0, send_ms);
+            uint64_t start = get_monotonic_time();
+            node_rx(&context[0], &ranging_msg, RxTimestamp);
+            sample[measured++] = get_monotonic_time() - start;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        context_free(&context[i]);
+    }
+    free(context);
+
+    Bench_Result_t result = {0};
+    for (int i = 0; i < messages; i++) {
+        result.mean += sample[i];
+    }
+    result.mean /= messages;
+    qsort(sample, messages, sizeof(uint64_t), compare_sample);
+    result.median = sample[messages / 2];
+    result.p99 = sample[(int)(messages * 0.99)];
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int max_neighbors = 128;
+    int messages = 100000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:l:h")) != -1) {
+        switch (opt) {
+            case 'n': max_neighbors = atoi(optarg); break;
+            case 'm': messages = atoi(optarg); break;
+            case 'l': packetLoss = atof(optarg); break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_neighbors < 2 || max_neighbors + 1 >= UWB_DEST_EMPTY || messages < 1) {
+        usage();
+        return 1;
+    }
+
+    // no trace: nothing is sampled, the cost measured is the Rx path of the simulator and the ranging library
+    nodeTrace = NULL;
+    uint64_t *sample = malloc(messages * sizeof(uint64_t));
+    double base = 0;
+    printf("%s, %d messages per size\n", RANGING_MODE, messages);
+    printf("%10s %12s %12s %12s %10s\n", "neighbors", "mean_ns", "median_ns", "p99_ns", "vs_first");
+    // 2, 4, 8, ... neighbors, ending at max_neighbors
+    for (int neighbors = 2; ; neighbors = neighbors * 2 < max_neighbors ? neighbors * 2 : max_neighbors) {
+        Bench_Result_t result = bench_run(neighbors, messages, sample);
+        if (base == 0) {
+            base = result.mean;
+        }
+        printf("%10d %12.1f %12lu %12lu %10.2f\n", neighbors, result.mean, result.median, result.p99, result.mean / base);
+        fflush(stdout);
+        if (neighbors == max_neighbors) {
+            break;
+        }
+    }
+    free(sample);
+    return 0;
+}
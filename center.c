@@ -1,230 +1,989 @@
+#include <getopt.h>
 #include "frame.h"
+#include "trace.h"
 
 
-Drone_Node_Set_t *droneNodeSet;
-sem_t allocation_sem;               // allocation of task(TX / RX)
-sem_t broadcast_sem;                // broadcast of messages
-sem_t response_sem;                 // response of simu_msg
-pthread_mutex_t response_mutex;
-int response_count = 0;
+#define     PACING_HIST_SIZE        24      // log2 buckets of slack in us, [2^k, 2^(k+1))
+#define     SESSION_MAX             64      // sessions held by one center, finished ones are reclaimed
+#define     SESSION_TRACE_LEN       256
+#define     CONTROL_ARGS_MAX        32      // key=value pairs of one control message
+#define     JOIN_ADDRESSES_MAX      (ADDRESS_INDEX_SIZE * 6)    // bytes of the address list of one join, continuations included
 
+typedef struct {
+    uint64_t callbacks;
+    uint64_t misses;                        // callbacks finished after the next event's deadline
+    uint64_t late_releases;                 // lines released after their scheduled time
+    int64_t worst_slack;
+    uint64_t slack_hist[PACING_HIST_SIZE];
+    uint64_t miss_hist[PACING_HIST_SIZE];
+} Pacing_Stats_t;                           // deadline accounting of paced replay
 
-void droneNodeSet_init() {
-    droneNodeSet = (Drone_Node_Set_t*)malloc(sizeof(Drone_Node_Set_t));
-    memset(droneNodeSet->node, 0, sizeof(droneNodeSet->node));
-    droneNodeSet->count = 0;
-    if(pthread_mutex_init(&droneNodeSet->mutex, NULL) != 0) {
-        perror("droneNodeSet->mutex init failed");
-        free(droneNodeSet);
-        droneNodeSet = NULL;
-        exit(EXIT_FAILURE);
+typedef enum {
+    SESSION_FREE,
+    SESSION_JOINING,                        // waiting for its drones
+    SESSION_RUNNING,
+    SESSION_FINISHED                        // completed or aborted, reclaimed once its drones are gone
+} Session_State_t;
+
+typedef enum {
+    STEP_DISPATCH,                          // Tx/Rx task allocation of the next line
+    STEP_BROADCAST                          // broadcast of the ranging message of the current line
+} Session_Step_t;
+
+typedef struct Session {
+    int id;
+    Session_State_t state;
+    char trace[SESSION_TRACE_LEN];
+    char mode[ADDR_SIZE];                   // ranging mode of the drones, any mode until the first join if empty
+    bool anyMode;                           // no mode at create, mode is taken from the first join
+    char params[PAYLOAD_SIZE / 2];          // " log=<path>" forwarded to joining drones
+    double timeDilation;
+    int rangingPeriodRate;
+    uint64_t windowStart;                   // replay window in system_time, windowEnd 0 replays to the end
+    uint64_t windowEnd;
+    uint64_t replayStart;                   // windowStart minus the warm-up, 0 replays from the first line
+    size_t rangingSize;                     // sizeof(Ranging_Message_t) in the drones' build
+    Drone_Node_Set_t nodeSet;
+    int16_t *nodeIndex;                     // UWB_Address_t -> position in nodeSet, -1 if not joined
+    int connections;
+    pthread_mutex_t mutex;                  // node set, state and trace position
+
+    // flight log position, only touched by the worker running the session
+    FILE *fp;
+    Session_Step_t step;
+    char *line;                             // grown by getline, kept by the slot for the next session
+    size_t lineSize;
+    char *nextLine;
+    size_t nextLineSize;
+    bool hasNext;
+    int rxCount;
+    bool sparse;                            // lines list only their receivers, after an rx_num column
+    int *rxNode;                            // hosted receivers of the current line
+    int rxNodeCount;
+    int lineCount;
+    uint64_t firstSystemTime;
+    uint64_t startTime;
+
+    // events reported by the drones
+    pthread_mutex_t eventMutex;
+    int pendingResponses;
+    bool pendingRanging;
+    Simu_Message_t broadcastMsg;            // ranging message waiting for broadcast
+    Pacing_Stats_t pacingStats;
+
+    // run queue, guarded by runQueue.mutex
+    uint64_t wakeTime;                      // release time of the next line in paced replay, 0 when unpaced
+    bool queued;
+    bool busy;                              // popped by a worker
+    struct Session *next;
+} Session_t;
+
+typedef struct {
+    char *command;
+    char *key[CONTROL_ARGS_MAX];
+    char *value[CONTROL_ARGS_MAX];
+    int count;
+} Control_Args_t;                           // "<command> key=value ..." payload of a control message
+
+
+Session_t sessionTable[SESSION_MAX];
+pthread_mutex_t sessionTableMutex = PTHREAD_MUTEX_INITIALIZER;
+int nextSessionId = DEFAULT_SESSION + 1;
+bool daemonMode = false;
+
+struct {
+    Session_t *head;
+    Session_t *tail;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} runQueue = {.mutex = PTHREAD_MUTEX_INITIALIZER};  // sessions whose next step can run, served round-robin
+
+
+uint64_t paced_time(Session_t *session, uint64_t system_time) {
+    // system_time is recorded in ms
+    uint64_t elapsed = system_time > session->firstSystemTime ? system_time - session->firstSystemTime : 0;
+    return session->startTime + (uint64_t)((double)elapsed * 1e6 * session->timeDilation);
+}
+
+int pacing_bucket(uint64_t us) {
+    int bucket = 0;
+    while (us > 1 && bucket < PACING_HIST_SIZE - 1) {
+        us >>= 1;
+        bucket++;
     }
+    return bucket;
+}
 
-    if (sem_init(&allocation_sem, 0, 1) != 0) {
-        perror("sem_init allocation_sem failed");
-        exit(EXIT_FAILURE);
+void pacing_record(Pacing_Stats_t *stats, int64_t slack) {
+    if (stats->callbacks == 0 || slack < stats->worst_slack) {
+        stats->worst_slack = slack;
     }
-    if (sem_init(&broadcast_sem, 0, 0) != 0) {
-        perror("sem_init broadcast_sem failed");
-        exit(EXIT_FAILURE);
+    stats->callbacks++;
+    if (slack < 0) {
+        stats->misses++;
+        stats->miss_hist[pacing_bucket((uint64_t)(-slack) / 1000)]++;
     }
-    if (sem_init(&response_sem, 0, 1) != 0) {
-        perror("sem_init response_sem failed");
-        exit(EXIT_FAILURE);
+    else {
+        stats->slack_hist[pacing_bucket((uint64_t)slack / 1000)]++;
     }
-    if (pthread_mutex_init(&response_mutex, NULL) != 0) {
-        perror("response_mutex init failed");
-        exit(EXIT_FAILURE);
+}
+
+void pacing_report(Session_t *session) {
+    pthread_mutex_lock(&session->eventMutex);
+    Pacing_Stats_t *stats = &session->pacingStats;
+    printf("Paced replay of session %d (dilation = %.2f): %lu callbacks, %lu deadline misses (%.2f%%), %lu late releases, worst slack = %.3f ms\n",
+           session->id, session->timeDilation, stats->callbacks, stats->misses,
+           stats->callbacks ? 100.0 * stats->misses / stats->callbacks : 0.0,
+           stats->late_releases, stats->worst_slack / 1e6);
+    printf("%-20s %12s %12s\n", "|slack| (us)", "on time", "missed");
+    for (int i = 0; i < PACING_HIST_SIZE; i++) {
+        if (stats->slack_hist[i] == 0 && stats->miss_hist[i] == 0) {
+            continue;
+        }
+        char range[32];
+        snprintf(range, sizeof(range), "[%lu, %lu)", i == 0 ? 0UL : 1UL << i, 1UL << (i + 1));
+        printf("%-20s %12lu %12lu\n", range, stats->slack_hist[i], stats->miss_hist[i]);
+    }
+    pthread_mutex_unlock(&session->eventMutex);
+}
+
+void control_parse(char *payload, Control_Args_t *args) {
+    char *saveptr;
+    args->count = 0;
+    args->command = strtok_r(payload, " \n", &saveptr);
+
+    char *token;
+    while ((token = strtok_r(NULL, " \n", &saveptr)) != NULL && args->count < CONTROL_ARGS_MAX) {
+        char *value = strchr(token, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        args->key[args->count] = token;
+        args->value[args->count] = value;
+        args->count++;
+    }
+}
+
+const char *control_get(const Control_Args_t *args, const char *key, const char *defaultValue) {
+    for (int i = 0; i < args->count; i++) {
+        if (strcmp(args->key[i], key) == 0) {
+            return args->value[i];
+        }
+    }
+    return defaultValue;
+}
+
+void control_reply(int node_socket, const char *format, ...) {
+    Simu_Message_t reply;
+    memset(&reply, 0, sizeof(Simu_Message_t));
+    strncpy(reply.srcAddress, CENTER_ADDRESS, ADDR_SIZE);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(reply.payload, PAYLOAD_SIZE, format, args);
+    va_end(args);
+    reply.size = strlen(reply.payload) + 1;
+
+    if (send(node_socket, &reply, sizeof(Simu_Message_t), 0) < 0) {
+        perror("Failed to send control reply");
+    }
+}
+
+/* run queue */
+void session_ready(Session_t *session) {
+    pthread_mutex_lock(&runQueue.mutex);
+    if (!session->queued) {
+        if (session->timeDilation > 0 && session->wakeTime > session->startTime && get_monotonic_time() > session->wakeTime) {
+            pthread_mutex_lock(&session->eventMutex);
+            session->pacingStats.late_releases++;
+            pthread_mutex_unlock(&session->eventMutex);
+        }
+        session->queued = true;
+        session->next = NULL;
+        if (runQueue.tail != NULL) {
+            runQueue.tail->next = session;
+        }
+        else {
+            runQueue.head = session;
+        }
+        runQueue.tail = session;
+        pthread_cond_broadcast(&runQueue.cond);
     }
+    pthread_mutex_unlock(&runQueue.mutex);
 }
 
-int count_rx_from_header(const char *header_line) {
-    int rx_count = 0;
-    char *copy = strdup(header_line);
-    char *token = strtok(copy, ",");
+/* first idle session in queue order whose release time has come; otherwise sleep until the earliest one */
+Session_t *session_pop() {
+    pthread_mutex_lock(&runQueue.mutex);
+    while (true) {
+        uint64_t now = get_monotonic_time();
+        uint64_t earliest = UINT64_MAX;
+        Session_t *prev = NULL;
+        for (Session_t *session = runQueue.head; session != NULL; prev = session, session = session->next) {
+            // queued again by its drones while its step is still running, it waits for session_release
+            if (session->busy) {
+                continue;
+            }
+            if (session->wakeTime <= now) {
+                if (prev != NULL) {
+                    prev->next = session->next;
+                }
+                else {
+                    runQueue.head = session->next;
+                }
+                if (runQueue.tail == session) {
+                    runQueue.tail = prev;
+                }
+                session->queued = false;
+                session->busy = true;
+                pthread_mutex_unlock(&runQueue.mutex);
+                return session;
+            }
+            if (session->wakeTime < earliest) {
+                earliest = session->wakeTime;
+            }
+        }
 
-    while (token != NULL) {
-        if (strncmp(token, "Rx", 2) == 0 && strstr(token, "_addr")) {
-            rx_count++;
+        if (earliest == UINT64_MAX) {
+            pthread_cond_wait(&runQueue.cond, &runQueue.mutex);
+        }
+        else {
+            struct timespec ts = {
+                .tv_sec = earliest / 1000000000ULL,
+                .tv_nsec = earliest % 1000000000ULL
+            };
+            pthread_cond_timedwait(&runQueue.cond, &runQueue.mutex, &ts);
         }
-        token = strtok(NULL, ",");
     }
+}
+
+void session_release(Session_t *session) {
+    pthread_mutex_lock(&runQueue.mutex);
+    session->busy = false;
+    if (session->queued) {
+        pthread_cond_broadcast(&runQueue.cond);
+    }
+    pthread_mutex_unlock(&runQueue.mutex);
+}
 
-    free(copy);
-    return rx_count;
+bool next_flightLog_line(Session_t *session) {
+    while (getline(&session->nextLine, &session->nextLineSize, session->fp) > 0) {
+        if (*session->nextLine == '\n' || *session->nextLine == '\0') {
+            break;
+        }
+        uint64_t system_time = strtoull(session->nextLine, NULL, 10);
+        if (system_time < session->replayStart) {
+            session->lineCount++;
+            continue;
+        }
+        if (session->windowEnd != 0 && system_time > session->windowEnd) {
+            break;
+        }
+        if ((session->lineCount++ / session->nodeSet.count) % session->rangingPeriodRate == 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
-void broadcast_rangingMessage(Simu_Message_t *simu_msg) {
-    for (int i = 0; i < droneNodeSet->count; i++) {
-        if (send(droneNodeSet->node[i].socket, simu_msg, sizeof(Simu_Message_t), 0) < 0) {
+int find_node(Session_t *session, uint16_t address) {
+    return session->nodeIndex[address];
+}
+
+void send_line_message(Session_t *session, int index, Line_Message_t *line_message) {
+    Simu_Message_t simu_msg;
+    strncpy(simu_msg.srcAddress, CENTER_ADDRESS, ADDR_SIZE);
+    strncpy(simu_msg.destAddress, session->nodeSet.node[index].address, ADDR_SIZE);
+    memcpy(simu_msg.payload, line_message, sizeof(Line_Message_t));
+    simu_msg.size = sizeof(Line_Message_t);
+
+    if (send(session->nodeSet.node[index].socket, &simu_msg, sizeof(Simu_Message_t), 0) < 0) {
+        perror(line_message->status == TX ? "Failed to send Tx message" : "Failed to send Rx message");
+    }
+}
+
+/* disconnect every drone of a finished session, their connection threads reclaim the rest */
+void session_close(Session_t *session) {
+    session->state = SESSION_FINISHED;
+    if (session->fp != NULL) {
+        fclose(session->fp);
+        session->fp = NULL;
+    }
+    for (int i = 0; i < session->nodeSet.count; i++) {
+        shutdown(session->nodeSet.node[i].socket, SHUT_RDWR);
+    }
+}
+
+void session_finish(Session_t *session) {
+    printf("Session %d: flight log broadcast completed.\n", session->id);
+    if (session->timeDilation > 0) {
+        pacing_report(session);
+    }
+    fflush(stdout);
+
+    // a single-run center exits with its only session, as it always did
+    if (!daemonMode && session->id == DEFAULT_SESSION) {
+        exit(EXIT_SUCCESS);
+    }
+    session_close(session);
+}
+
+/* false when no hosted drone gets a copy, so no response will come */
+bool broadcast_rangingMessage(Session_t *session, Simu_Message_t *simu_msg) {
+    // a sparse trace lists who heard the message, nobody else gets a copy
+    int count = session->sparse ? session->rxNodeCount : session->nodeSet.count;
+    int sent = 0;
+    for (int i = 0; i < count; i++) {
+        int index = session->sparse ? session->rxNode[i] : i;
+        // drones hosted in one process share a socket, so every copy is tagged with its destination
+        if (strcmp(session->nodeSet.node[index].address, simu_msg->srcAddress) == 0) {
+            continue;
+        }
+        sent++;
+    }
+
+    pthread_mutex_lock(&session->eventMutex);
+    session->pendingResponses = sent;
+    pthread_mutex_unlock(&session->eventMutex);
+
+    for (int i = 0; i < count; i++) {
+        int index = session->sparse ? session->rxNode[i] : i;
+        if (strcmp(session->nodeSet.node[index].address, simu_msg->srcAddress) == 0) {
+            continue;
+        }
+        strncpy(simu_msg->destAddress, session->nodeSet.node[index].address, ADDR_SIZE);
+        if (send(session->nodeSet.node[index].socket, simu_msg, sizeof(Simu_Message_t), 0) < 0) {
             perror("Failed to broadcast message");
         }
     }
+    return sent > 0;
 }
 
-void *broadcast_flightLog(void *arg) {
-    FILE *fp = fopen(FILE_NAME, "r");
-    if (!fp) {
-        perror("Failed to open file");
-        return NULL;
+/* Tx and Rx task allocation of one line of the flight log, false when no hosted drone takes part in it */
+bool broadcast_flightLog(Session_t *session) {
+    char *line = session->line;
+    size_t line_size = session->lineSize;
+    session->line = session->nextLine;
+    session->lineSize = session->nextLineSize;
+    session->nextLine = line;
+    session->nextLineSize = line_size;
+    session->hasNext = next_flightLog_line(session);
+
+    // paced replay: the next line is released at its recorded system_time spacing, scaled by the dilation
+    uint64_t deadline = 0;
+    if (session->timeDilation > 0 && session->hasNext) {
+        deadline = paced_time(session, strtoull(session->nextLine, NULL, 10));
     }
 
-    char line[MAX_LINE_LEN];
+    // Tx task allocation
+    Line_Message_t Tx_line_message;
+    char *saveptr;
+    char *token = strtok_r(session->line, ",", &saveptr);
+    bool warmup = strtoull(token, NULL, 10) < session->windowStart;
+    token = strtok_r(NULL, ",", &saveptr);
+    Tx_line_message.address = (uint16_t)strtoul(token, NULL, 10);
+    Tx_line_message.warmup = warmup;
+    Tx_line_message.status = TX;
+    Tx_line_message.deadline = deadline;
+    Tx_line_message.slack = 0;
+    for (int i = 0; i < 3; i++) {
+        token = strtok_r(NULL, ",", &saveptr);
+    }
+    Tx_line_message.timestamp.full = (uint64_t)strtoull(token, NULL, 10);
 
-    if (!fgets(line, sizeof(line), fp)) {
+    // Rx task allocation, only for receivers hosted by the session
+    int rx_num = session->rxCount;
+    if (session->sparse) {
+        token = strtok_r(NULL, ",", &saveptr);
+        rx_num = token ? (int)strtoul(token, NULL, 10) : 0;
+    }
+    Line_Message_t Rx_line_message[session->nodeSet.count + 1];
+    int responses = 0;
+    for (int i = 0; i < rx_num; i++) {
+        char *address = strtok_r(NULL, ",", &saveptr);
+        token = strtok_r(NULL, ",", &saveptr);
+        if (address == NULL) {
+            break;
+        }
+        int node = find_node(session, (uint16_t)strtoul(address, NULL, 10));
+        if (node < 0 || responses == session->nodeSet.count) {
+            continue;
+        }
+        Rx_line_message[responses].address = (uint16_t)strtoul(address, NULL, 10);
+        Rx_line_message[responses].warmup = warmup;
+        Rx_line_message[responses].status = RX;
+        Rx_line_message[responses].deadline = deadline;
+        Rx_line_message[responses].slack = 0;
+        Rx_line_message[responses].timestamp.full = token ? (uint64_t)strtoull(token, NULL, 10) : 0;
+        session->rxNode[responses++] = node;
+    }
+    session->rxNodeCount = responses;
+
+    int Tx_node = find_node(session, Tx_line_message.address);
+    session->step = STEP_BROADCAST;
+    session->wakeTime = 0;
+    pthread_mutex_lock(&session->eventMutex);
+    session->pendingRanging = Tx_node >= 0;
+    session->pendingResponses = responses;
+    pthread_mutex_unlock(&session->eventMutex);
+
+    if (Tx_node >= 0) {
+        printf("[broadcast_flightLog %d]: Tx address = %d, Tx timestamp = %lu\n", session->id, Tx_line_message.address, Tx_line_message.timestamp.full);
+        send_line_message(session, Tx_node, &Tx_line_message);
+    }
+    for (int i = 0; i < responses; i++) {
+        printf("[broadcast_flightLog %d]: Rx address = %d, Rx timestamp = %lu\n", session->id, Rx_line_message[i].address, Rx_line_message[i].timestamp.full);
+        send_line_message(session, session->rxNode[i], &Rx_line_message[i]);
+    }
+    return Tx_node >= 0 || responses > 0;
+}
+
+/* one step of a session: allocation of the next line, or broadcast of the ranging message it produced */
+void session_step(Session_t *session) {
+    pthread_mutex_lock(&session->mutex);
+    if (session->state != SESSION_RUNNING) {
+        pthread_mutex_unlock(&session->mutex);
+        return;
+    }
+
+    bool waiting;
+    if (session->step == STEP_BROADCAST) {
+        pthread_mutex_lock(&session->eventMutex);
+        Simu_Message_t simu_msg = session->broadcastMsg;
+        pthread_mutex_unlock(&session->eventMutex);
+
+        session->step = STEP_DISPATCH;
+        if (session->timeDilation > 0 && session->hasNext) {
+            session->wakeTime = paced_time(session, strtoull(session->nextLine, NULL, 10));
+        }
+        waiting = broadcast_rangingMessage(session, &simu_msg);
+    }
+    else if (session->hasNext) {
+        waiting = broadcast_flightLog(session);
+    }
+    else {
+        // the callbacks of the last line are in
+        session_finish(session);
+        pthread_mutex_unlock(&session->mutex);
+        return;
+    }
+
+    // nothing to wait for, e.g. a line that no hosted drone received. Decided from what this step sent: once a
+    // message is out, its responses may already have drained the counters and queued the session in handle_message
+    pthread_mutex_unlock(&session->mutex);
+    if (!waiting) {
+        session_ready(session);
+    }
+}
+
+void *session_worker(void *arg) {
+    while (true) {
+        Session_t *session = session_pop();
+        session_step(session);
+        session_release(session);
+    }
+    return NULL;
+}
+
+/* all drones joined: open the flight log and queue the first line */
+void session_start(Session_t *session) {
+    session->fp = trace_fopen(session->trace);
+    if (!session->fp) {
+        perror("Failed to open file");
+        session_close(session);
+        return;
+    }
+
+    if (getline(&session->line, &session->lineSize, session->fp) <= 0) {
         fprintf(stderr, "Empty file\n");
-        fclose(fp);
+        session_close(session);
+        return;
+    }
+    session->sparse = trace_is_sparse(session->line);
+    session->rxCount = session->sparse ? 0 : trace_count_rx(session->line);
+    session->rxNode = realloc(session->rxNode, (session->nodeSet.count + 1) * sizeof(int));
+    session->rxNodeCount = 0;
+    if (session->sparse) {
+        printf("Session %d: all drones connected, sparse receiver lists\n", session->id);
+    }
+    else {
+        printf("Session %d: all drones connected, detected Rx count: %d\n", session->id, session->rxCount);
+    }
+
+    // Check if the number of drones matches the count from the file, a sparse header does not tell
+    int drone_num = session->rxCount + 1;
+    if (!session->sparse && drone_num != session->nodeSet.count) {
+        printf("Warning: session %d has %d drones, but drone_num read from file = %d\n", session->id, session->nodeSet.count, drone_num);
+        if (!daemonMode) {
+            exit(EXIT_FAILURE);
+        }
+        session_close(session);
+        return;
+    }
+
+    // a replay window starts at the indexed line before its warm-up instead of the first line
+    uint64_t line = 0;
+    if (session->replayStart > 0 && trace_seek(session->fp, session->trace, session->replayStart, &line) < 0) {
+        session_close(session);
+        return;
+    }
+    session->lineCount = (int)line;
+    session->hasNext = next_flightLog_line(session);
+    session->firstSystemTime = session->hasNext ? strtoull(session->nextLine, NULL, 10) : 0;
+    session->startTime = get_monotonic_time();
+    session->step = STEP_DISPATCH;
+    session->wakeTime = session->timeDilation > 0 ? session->startTime : 0;
+    session->state = SESSION_RUNNING;
+}
+
+/* free slots of finished sessions whose drones are gone and which no worker holds */
+void session_reclaim() {
+    for (int i = 0; i < SESSION_MAX; i++) {
+        Session_t *session = &sessionTable[i];
+        pthread_mutex_lock(&session->mutex);
+        pthread_mutex_lock(&runQueue.mutex);
+        if (session->state == SESSION_FINISHED && session->connections == 0 && !session->queued && !session->busy) {
+            free(session->nodeSet.node);
+            session->nodeSet.node = NULL;
+            free(session->rxNode);
+            session->rxNode = NULL;
+            free(session->nodeIndex);
+            session->nodeIndex = NULL;
+            session->state = SESSION_FREE;
+        }
+        pthread_mutex_unlock(&runQueue.mutex);
+        pthread_mutex_unlock(&session->mutex);
+    }
+}
+
+/* "start:end" window in system_time, replayed after warmup ms of the trace before it */
+bool session_window(Session_t *session, const char *window, uint64_t warmup) {
+    if (window == NULL) {
+        return true;
+    }
+    unsigned long long start, end;
+    if (sscanf(window, "%llu:%llu", &start, &end) != 2) {
+        return false;
+    }
+    session->windowStart = start;
+    session->windowEnd = end;
+    session->replayStart = start > warmup ? start - warmup : 0;
+    return true;
+}
+
+Session_t *session_create(int id, const char *trace, const char *mode, int nodes, double time_dilation, int rate, const Control_Args_t *args) {
+    pthread_mutex_lock(&sessionTableMutex);
+    session_reclaim();
+
+    Session_t *session = NULL;
+    for (int i = 0; i < SESSION_MAX; i++) {
+        if (sessionTable[i].state == SESSION_FREE) {
+            session = &sessionTable[i];
+            break;
+        }
+    }
+    if (session == NULL) {
+        pthread_mutex_unlock(&sessionTableMutex);
         return NULL;
     }
-    int rx_count = count_rx_from_header(line);
-    printf("Detected Rx count: %d\n", rx_count);
 
-    // Check if the number of drones matches the count from the file
-    int drone_num = rx_count + 1;
-    if(drone_num != droneNodeSet->count) {
-        printf("Warning: droneNodeSet->count = %d, but drone_num read from file = %d\n", droneNodeSet->count, drone_num);
-        exit(EXIT_FAILURE);
+    pthread_mutex_lock(&session->mutex);
+    session->id = id >= 0 ? id : nextSessionId++;
+    snprintf(session->trace, sizeof(session->trace), "%s", trace);
+    snprintf(session->mode, sizeof(session->mode), "%s", mode);
+    session->anyMode = *mode == '\0';
+    session->params[0] = '\0';
+    for (int i = 0; args != NULL && i < args->count; i++) {
+        if (strcmp(args->key[i], "log") == 0) {
+            size_t used = strlen(session->params);
+            snprintf(session->params + used, sizeof(session->params) - used, " %s=%s", args->key[i], args->value[i]);
+        }
     }
+    session->timeDilation = time_dilation;
+    session->rangingPeriodRate = rate > 0 ? rate : 1;
+    session->windowStart = 0;
+    session->windowEnd = 0;
+    session->replayStart = 0;
+    if (args != NULL) {
+        const char *warmup = control_get(args, "warmup", NULL);
+        session_window(session, control_get(args, "window", NULL), warmup != NULL ? strtoull(warmup, NULL, 10) : REPLAY_WARMUP);
+    }
+    session->rangingSize = 0;
+    session->nodeSet.node = calloc(nodes, sizeof(Drone_Node_t));
+    session->nodeSet.count = 0;
+    session->nodeSet.capacity = nodes;
+    session->nodeIndex = malloc(ADDRESS_INDEX_SIZE * sizeof(int16_t));
+    memset(session->nodeIndex, -1, ADDRESS_INDEX_SIZE * sizeof(int16_t));
+    session->connections = 0;
+    session->fp = NULL;
+    session->pendingResponses = 0;
+    session->pendingRanging = false;
+    memset(&session->pacingStats, 0, sizeof(Pacing_Stats_t));
+    session->wakeTime = 0;
+    session->state = SESSION_JOINING;
+    pthread_mutex_unlock(&session->mutex);
 
-    int line_count = 0;
+    pthread_mutex_unlock(&sessionTableMutex);
+    return session;
+}
 
-    // Broadcast flight log to all drones
-    while (fgets(line, sizeof(line), fp)) {
-        if((line_count++ / NODES_NUM) % RANGING_PERIOD_RATE == 0) {
-            if (*line == '\n' || *line == '\0') {
-                break;
-            }
+Session_t *session_find(int id) {
+    pthread_mutex_lock(&sessionTableMutex);
+    for (int i = 0; i < SESSION_MAX; i++) {
+        if (sessionTable[i].state != SESSION_FREE && sessionTable[i].id == id) {
+            pthread_mutex_unlock(&sessionTableMutex);
+            return &sessionTable[i];
+        }
+    }
+    pthread_mutex_unlock(&sessionTableMutex);
+    return NULL;
+}
 
-            sem_wait(&allocation_sem);
-            sem_wait(&response_sem);
-
-            // Tx task allocation
-            Line_Message_t Tx_line_message;
-            char *token = strtok(line, ",");
-            token = strtok(NULL, ",");
-            Tx_line_message.address = (uint16_t)strtoul(token, NULL, 10);
-            Tx_line_message.status = TX;
-            for (int i = 0; i < 3; i++) {
-                token = strtok(NULL, ",");
-            }
-            Tx_line_message.timestamp.full = (uint64_t)strtoull(token, NULL, 10);
+void session_list(int node_socket) {
+    static const char *state_name[] = {"free", "joining", "running", "finished"};
+    char list[PAYLOAD_SIZE] = "ok";
 
-            for(int i = 0; i < droneNodeSet->count; i++) {
-                if((uint16_t)strtoul(droneNodeSet->node[i].address, NULL, 10) == Tx_line_message.address) {
-                    printf("[broadcast_flightLog]: Tx address = %d, Tx timestamp = %lu\n", Tx_line_message.address, Tx_line_message.timestamp.full);
+    pthread_mutex_lock(&sessionTableMutex);
+    for (int i = 0; i < SESSION_MAX; i++) {
+        Session_t *session = &sessionTable[i];
+        if (session->state == SESSION_FREE) {
+            continue;
+        }
+        size_t used = strlen(list);
+        snprintf(list + used, sizeof(list) - used, "\n%d %s %d/%d %s", session->id, state_name[session->state],
+                 session->nodeSet.count, session->nodeSet.capacity, session->trace);
+    }
+    pthread_mutex_unlock(&sessionTableMutex);
 
-                    Simu_Message_t simu_msg;
-                    strncpy(simu_msg.srcAddress, CENTER_ADDRESS, ADDR_SIZE);
-                    memcpy(simu_msg.payload, &Tx_line_message, sizeof(Line_Message_t));
-                    simu_msg.size = sizeof(Line_Message_t);
+    control_reply(node_socket, "%s", list);
+}
 
-                    if(send(droneNodeSet->node[i].socket, &simu_msg, sizeof(Simu_Message_t), 0) < 0) {
-                        perror("Failed to send Tx message");
-                    }
-                }
-            }
+/* false if an address of a join is 0, reserved, already in the session or repeated in the list; error names it */
+bool join_addresses_valid(const Session_t *session, const char *addresses, char *error, size_t error_size) {
+    char *list = strdup(addresses);
+    bool *listed = calloc(ADDRESS_INDEX_SIZE, sizeof(bool));
+    bool valid = true;
+    char *saveptr;
+    for (char *token = strtok_r(list, ",", &saveptr); valid && token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+        unsigned long address = strtoul(token, NULL, 10);
+        valid = address != 0 && address < UWB_DEST_EMPTY && session->nodeIndex[address] < 0 && !listed[address];
+        if (valid) {
+            listed[address] = true;
+        }
+        else {
+            snprintf(error, error_size, "drone %.20s is invalid or already joined the session", token);
+        }
+    }
+    free(listed);
+    free(list);
+    return valid;
+}
 
-            // Rx task allocation
-            for(int i = 0; i < rx_count; i++) {
-                Line_Message_t Rx_line_message;
-                token = strtok(NULL, ",");
-                Rx_line_message.address = (uint16_t)strtoul(token, NULL, 10);
-                Rx_line_message.status = RX;
-                token = strtok(NULL, ",");
-                Rx_line_message.timestamp.full = (uint64_t)strtoull(token, NULL, 10);
-
-                for(int j = 0; j < droneNodeSet->count; j++) {
-                    if((uint16_t)strtoul(droneNodeSet->node[j].address, NULL, 10) == Rx_line_message.address) {
-                        printf("[broadcast_flightLog]: Rx address = %d, Rx timestamp = %lu\n", Rx_line_message.address, Rx_line_message.timestamp.full);
-
-                        Simu_Message_t simu_msg;
-                        strncpy(simu_msg.srcAddress, CENTER_ADDRESS, ADDR_SIZE);
-                        memcpy(simu_msg.payload, &Rx_line_message, sizeof(Line_Message_t));
-                        simu_msg.size = sizeof(Line_Message_t);
-
-                        if(send(droneNodeSet->node[j].socket, &simu_msg, sizeof(Simu_Message_t), 0) < 0) {
-                            perror("Failed to send Rx message");
-                        }
-                    }
-                }
-            }
-            sem_post(&broadcast_sem);
-        }       
+/* address list of a join and of the joins that follow it while they carry more=1, NULL if the list cannot be read */
+char *join_addresses(int node_socket, Simu_Message_t *simu_msg, Control_Args_t *args) {
+    size_t size = PAYLOAD_SIZE;
+    char *addresses = malloc(size);
+    snprintf(addresses, size, "%s", control_get(args, "addresses", ""));
+    while (strcmp(control_get(args, "more", "0"), "1") == 0) {
+        if (recv(node_socket, simu_msg, sizeof(Simu_Message_t), MSG_WAITALL) <= 0) {
+            free(addresses);
+            return NULL;
+        }
+        simu_msg->payload[PAYLOAD_SIZE - 1] = '\0';
+        control_parse(simu_msg->payload, args);
+
+        const char *more = control_get(args, "addresses", "");
+        size_t used = strlen(addresses);
+        if (args->command == NULL || strcmp(args->command, "join") != 0 || used + strlen(more) + 2 > JOIN_ADDRESSES_MAX) {
+            control_reply(node_socket, "error join continuation expected, at most %d bytes of addresses", JOIN_ADDRESSES_MAX);
+            free(addresses);
+            return NULL;
+        }
+        if (used + strlen(more) + 2 > size) {
+            size = 2 * size + strlen(more);
+            addresses = realloc(addresses, size);
+        }
+        snprintf(addresses + used, size - used, "%s%s", used > 0 ? "," : "", more);
     }
+    return addresses;
+}
 
-    printf("Flight log broadcast completed.\n");
-    fclose(fp);
+/* join <session=id> mode=<mode> ranging_size=<bytes> addresses=1,2,3, addresses gathered by join_addresses */
+Session_t *session_join(int node_socket, const Control_Args_t *args, char *addresses) {
+    int id = atoi(control_get(args, "session", "0"));
+    Session_t *session = session_find(id);
+    if (session == NULL) {
+        control_reply(node_socket, "error unknown session");
+        return NULL;
+    }
 
-    exit(EXIT_SUCCESS);
-    return NULL;
+    pthread_mutex_lock(&session->mutex);
+    if (session->id != id) {
+        // the slot was reclaimed and reused in between
+        pthread_mutex_unlock(&session->mutex);
+        control_reply(node_socket, "error unknown session");
+        return NULL;
+    }
+    const char *mode = control_get(args, "mode", "");
+    size_t ranging_size = (size_t)strtoul(control_get(args, "ranging_size", "0"), NULL, 10);
+
+    const char *error = NULL;
+    char address_error[96];
+    int count = 0;
+    for (char *c = addresses; *c; c++) {
+        count += *c == ',';
+    }
+    count += *addresses != '\0';
+
+    if (session->state != SESSION_JOINING) {
+        error = "session is not accepting drones";
+    }
+    else if (*session->mode && strcmp(session->mode, mode) != 0) {
+        error = "ranging mode differs from the session";
+    }
+    else if (session->rangingSize != 0 && session->rangingSize != ranging_size) {
+        error = "ranging message layout differs from the session";
+    }
+    else if (count == 0 || session->nodeSet.count + count > session->nodeSet.capacity) {
+        error = "too many drones for the session";
+    }
+    else if (!join_addresses_valid(session, addresses, address_error, sizeof(address_error))) {
+        error = address_error;
+    }
+    if (error != NULL) {
+        control_reply(node_socket, "error %s", error);
+        pthread_mutex_unlock(&session->mutex);
+        return NULL;
+    }
+
+    snprintf(session->mode, sizeof(session->mode), "%s", mode);
+    session->rangingSize = ranging_size;
+    session->connections++;
+    char *saveptr;
+    for (char *token = strtok_r(addresses, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+        session->nodeIndex[(uint16_t)strtoul(token, NULL, 10)] = (int16_t)session->nodeSet.count;
+        Drone_Node_t *node = &session->nodeSet.node[session->nodeSet.count++];
+        node->socket = node_socket;
+        strncpy(node->address, token, ADDR_SIZE - 1);
+        printf("New drone connected to session %d: %s\n", session->id, token);
+    }
+
+    // the reply must reach the drones before the first line of the session
+    control_reply(node_socket, "ok session=%d trace=%s%s", session->id, session->trace, session->params);
+
+    bool start = session->nodeSet.count == session->nodeSet.capacity;
+    if (start) {
+        session_start(session);
+    }
+    pthread_mutex_unlock(&session->mutex);
+
+    if (start && session->state == SESSION_RUNNING) {
+        session_ready(session);
+    }
+    return session;
+}
+
+void handle_message(Session_t *session, Simu_Message_t *simu_msg) {
+    bool ready = false;
+
+    pthread_mutex_lock(&session->eventMutex);
+    if (simu_msg->size == session->rangingSize) {
+        session->broadcastMsg = *simu_msg;
+        session->pendingRanging = false;
+        ready = session->pendingResponses == 0;
+    }
+    else if (simu_msg->size == sizeof(Line_Message_t)) {
+        Line_Message_t *report = (Line_Message_t*)simu_msg->payload;
+        if (report->deadline != 0) {
+            pacing_record(&session->pacingStats, report->slack);
+        }
+        // Tx reports only carry lateness
+        if (report->status != TX && session->pendingResponses > 0) {
+            session->pendingResponses--;
+            ready = session->pendingResponses == 0 && !session->pendingRanging;
+        }
+    }
+    pthread_mutex_unlock(&session->eventMutex);
+
+    if (ready) {
+        session_ready(session);
+    }
 }
 
 void *handle_node_connection(void *arg) {
     int node_socket = *(int*)arg;
     free(arg);
 
-    char node_address[ADDR_SIZE];
-    ssize_t bytes_received = recv(node_socket, node_address, sizeof(node_address), 0);
+    // the first message of a connection is a control message: create, list or join
+    Simu_Message_t simu_msg;
+    ssize_t bytes_received = recv(node_socket, &simu_msg, sizeof(simu_msg), MSG_WAITALL);
     if (bytes_received <= 0) {
         close(node_socket);
         return NULL;
     }
-    node_address[bytes_received] = '\0';
-    
-    droneNodeSet->node[droneNodeSet->count].socket = node_socket;
-    strncpy(droneNodeSet->node[droneNodeSet->count].address, node_address, ADDR_SIZE);
-    droneNodeSet->count++;
-    pthread_mutex_unlock(&droneNodeSet->mutex);
-    printf("New drone connected: %s\n", droneNodeSet->node[droneNodeSet->count - 1].address);
+    simu_msg.payload[PAYLOAD_SIZE - 1] = '\0';
 
-    // Broadcast received message to all nodes
-    Simu_Message_t simu_msg;
-    while ((bytes_received = recv(node_socket, &simu_msg, sizeof(simu_msg), 0)) > 0) {
-        if(simu_msg.size == sizeof(Ranging_Message_t)) {
-            Ranging_Message_t *ranging_msg = (Ranging_Message_t*)simu_msg.payload;
-            // printf("[broadcast_rangingMessage]: address = %d, msgSeq = %d\n", ranging_msg->header.srcAddress, ranging_msg->header.msgSequence);
-            
-            sem_wait(&broadcast_sem);
-            sem_wait(&response_sem);
-            broadcast_rangingMessage(&simu_msg);
-            sem_post(&allocation_sem);
-        }
-        else if(simu_msg.size == sizeof(Line_Message_t)) {
-            pthread_mutex_lock(&response_mutex);
-            response_count++;
-            if(response_count == NODES_NUM - 1) {
-                // All responses received
-                sem_post(&response_sem);
-                response_count = 0;
+    Control_Args_t args;
+    control_parse(simu_msg.payload, &args);
+
+    Session_t *session = NULL;
+    if (args.command != NULL && strcmp(args.command, "join") == 0) {
+        // a drone hosting more addresses than one payload holds sends them over several joins
+        char *addresses = join_addresses(node_socket, &simu_msg, &args);
+        if (addresses != NULL) {
+            session = session_join(node_socket, &args, addresses);
+            free(addresses);
+        }
+    }
+    else if (args.command != NULL && strcmp(args.command, "create") == 0) {
+        int nodes = atoi(control_get(&args, "nodes", "0"));
+        double time_dilation = atof(control_get(&args, "dilation", "0"));
+        const char *window = control_get(&args, "window", NULL);
+        unsigned long long window_start, window_end;
+        if (nodes <= 0 || nodes > INT16_MAX || (time_dilation != 0 && (time_dilation < 0.1 || time_dilation > 100))) {
+            control_reply(node_socket, "error nodes must be in [1, 32767] and dilation 0 or in [0.1, 100]");
+        }
+        else if (window != NULL && sscanf(window, "%llu:%llu", &window_start, &window_end) != 2) {
+            control_reply(node_socket, "error window must be start:end");
+        }
+        else {
+            Session_t *created = session_create(-1, control_get(&args, "trace", FILE_NAME), control_get(&args, "mode", ""),
+                                                nodes, time_dilation, atoi(control_get(&args, "rate", "1")), &args);
+            if (created != NULL) {
+                printf("Session %d created: %d drones, trace %s\n", created->id, nodes, created->trace);
+                control_reply(node_socket, "ok session=%d", created->id);
+            }
+            else {
+                control_reply(node_socket, "error session table full");
             }
-            pthread_mutex_unlock(&response_mutex);
         }
+    }
+    else if (args.command != NULL && strcmp(args.command, "list") == 0) {
+        session_list(node_socket);
+    }
+    else {
+        control_reply(node_socket, "error unknown command");
+    }
+
+    if (session == NULL) {
+        close(node_socket);
+        return NULL;
+    }
 
+    while ((bytes_received = recv(node_socket, &simu_msg, sizeof(simu_msg), MSG_WAITALL)) > 0) {
+        handle_message(session, &simu_msg);
     }
 
     // Handle disconnection
-    pthread_mutex_lock(&droneNodeSet->mutex);
-    for (int i = 0; i < droneNodeSet->count; i++) {
-        // Find the node that matches the disconnected socket
-        if (droneNodeSet->node[i].socket == node_socket) {
-            printf("Node %s disconnected\n", droneNodeSet->node[i].address);
-            for(int j = i + 1; j < droneNodeSet->count; j++) {
-                droneNodeSet->node[j - 1] = droneNodeSet->node[j];
+    pthread_mutex_lock(&session->mutex);
+    bool running = session->state == SESSION_RUNNING;
+    for (int i = 0; i < session->nodeSet.count; ) {
+        // Find every node hosted behind the disconnected socket
+        if (session->nodeSet.node[i].socket == node_socket) {
+            printf("Node %s of session %d disconnected\n", session->nodeSet.node[i].address, session->id);
+            session->nodeIndex[(uint16_t)strtoul(session->nodeSet.node[i].address, NULL, 10)] = -1;
+            for (int j = i + 1; j < session->nodeSet.count; j++) {
+                session->nodeSet.node[j - 1] = session->nodeSet.node[j];
+                session->nodeIndex[(uint16_t)strtoul(session->nodeSet.node[j - 1].address, NULL, 10)] = (int16_t)(j - 1);
             }
             // Clear the last node
-            memset(&droneNodeSet->node[droneNodeSet->count - 1], 0, sizeof(Drone_Node_t));
-            droneNodeSet->count--;
-            break;
+            memset(&session->nodeSet.node[session->nodeSet.count - 1], 0, sizeof(Drone_Node_t));
+            session->nodeSet.count--;
+        }
+        else {
+            i++;
         }
     }
-    pthread_mutex_unlock(&droneNodeSet->mutex);
-
+    session->connections--;
+    if (session->nodeSet.count == 0) {
+        // a session left by all its drones takes the next ones as a fresh one would
+        if (session->anyMode) {
+            session->mode[0] = '\0';
+        }
+        session->rangingSize = 0;
+    }
+    if (running) {
+        // the lockstep cannot go on without the drone, release the others
+        printf("Session %d aborted\n", session->id);
+        if (!daemonMode && session->id == DEFAULT_SESSION) {
+            exit(EXIT_FAILURE);
+        }
+        session_close(session);
+    }
     close(node_socket);
+    pthread_mutex_unlock(&session->mutex);
     return NULL;
 }
 
-int main() {
-    droneNodeSet_init();
+void usage() {
+    printf("Usage: ./center [-d] [-w workers] [-R window_start:window_end [-u warmup_ms]] [time_dilation]\n");
+    printf("  time_dilation in [0.1, 100] or 0 for unpaced replay of the default session\n");
+    printf("  -d  keep running and serve sessions created by clients, without a default session\n");
+    printf("  -w  worker threads stepping the sessions, default is the number of cores\n");
+    printf("  -R  replay only this system_time window of the default session, after -u ms of warm-up (default %d)\n", REPLAY_WARMUP);
+}
+
+int main(int argc, char *argv[]) {
+    double time_dilation = TIME_DILATION;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *window = NULL;
+    uint64_t warmup = REPLAY_WARMUP;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "dw:R:u:h")) != -1) {
+        switch (opt) {
+            case 'd': daemonMode = true; break;
+            case 'w': workers = atoi(optarg); break;
+            case 'R': window = optarg; break;
+            case 'u': warmup = strtoull(optarg, NULL, 10); break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        time_dilation = atof(argv[optind]);
+    }
+    if (workers <= 0 || (time_dilation != 0 && (time_dilation < 0.1 || time_dilation > 100))) {
+        usage();
+        return 1;
+    }
+
+    for (int i = 0; i < SESSION_MAX; i++) {
+        if (pthread_mutex_init(&sessionTable[i].mutex, NULL) != 0 || pthread_mutex_init(&sessionTable[i].eventMutex, NULL) != 0) {
+            perror("session mutex init failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // release times are CLOCK_MONOTONIC, like get_monotonic_time()
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    if (pthread_cond_init(&runQueue.cond, &cond_attr) != 0) {
+        perror("runQueue.cond init failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_condattr_destroy(&cond_attr);
+
+    // a single-run center serves the default session, which the drones join without --session
+    if (!daemonMode) {
+        Session_t *session = session_create(DEFAULT_SESSION, FILE_NAME, RANGING_MODE, NODES_NUM, time_dilation, RANGING_PERIOD_RATE, NULL);
+        if (!session_window(session, window, warmup)) {
+            usage();
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < workers; i++) {
+        pthread_t worker_thread;
+        if (pthread_create(&worker_thread, NULL, session_worker, NULL) != 0) {
+            perror("Failed to create worker thread");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(worker_thread);
+    }
 
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
@@ -232,7 +991,7 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    int opt = 1;
+    opt = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("setsockopt");
         exit(EXIT_FAILURE);
@@ -249,13 +1008,18 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, NODES_NUM) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen");
         exit(EXIT_FAILURE);
     }
 
-    printf("Control Center started on port %d (Max drones: %d)\n", CENTER_PORT, NODES_NUM);
-    printf("Waiting for drone connections...\n");
+    if (daemonMode) {
+        printf("Control Center started on port %d in session mode (%d workers)\n", CENTER_PORT, workers);
+    }
+    else {
+        printf("Control Center started on port %d (Max drones: %d)\n", CENTER_PORT, NODES_NUM);
+        printf("Waiting for drone connections...\n");
+    }
 
     while (1) {
         struct sockaddr_in client_addr;
@@ -273,33 +1037,19 @@ int main() {
             continue;
         }
 
-        pthread_mutex_lock(&droneNodeSet->mutex);
+        // lockstep messages are small request/response pairs, Nagle would delay each of them
+        setsockopt(*new_socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
         pthread_t thread_id;
         if (pthread_create(&thread_id, NULL, handle_node_connection, new_socket) != 0) {
             perror("pthread_create");
             close(*new_socket);
             free(new_socket);
+            continue;
         }
         pthread_detach(thread_id);
-
-        // make sure all drones connected before broadcast flightLog
-        pthread_mutex_lock(&droneNodeSet->mutex);
-        if (droneNodeSet->count == NODES_NUM) {
-            pthread_mutex_unlock(&droneNodeSet->mutex);
-            break;
-        }
-        pthread_mutex_unlock(&droneNodeSet->mutex);
     }
 
-    printf("All drones connected, starting flight log broadcast...\n");
-
-    // broadcast flightLog
-    pthread_t broadcast_thread;
-    pthread_create(&broadcast_thread, NULL, broadcast_flightLog, NULL);
-
-    while (droneNodeSet->count);
-
-    pthread_detach(broadcast_thread);
     close(server_fd);
     return 0;
-}
\ No newline at end of file
+}
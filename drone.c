@@ -1,135 +1,59 @@
 #define _POSIX_C_SOURCE 200809L 
-#include "frame.h"
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include "launch.h"
+#include "node.h"
 
 
-const char* localAddress;
-#if defined(CLASSIC_RANGING_MODE)
-extern Ranging_Table_Set_t rangingTableSet;
-#elif defined(MODIFIED_RANGING_MODE)
-extern Ranging_Table_Set_t *rangingTableSet;
-#endif
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;      // mutex for synchronizing access to the rangingTableSet
-extern dwTime_t lastTxTimestamp;                              
-extern dwTime_t lastRxTimestamp;                              
 extern dwTime_t TxTimestamp;                            // store timestamp from flightLog
 extern dwTime_t RxTimestamp;                            // store timestamp from flightLog
-#define MAX_LINE 512
-#define DELIM ","
-#define MAX_ROWS 7000
-static char *csv_lines[MAX_ROWS];
-static int total_rows = 0;
-static int csv_pos = 0;
-
-
-#if defined(IEEE_802_15_4Z)
-#define     RANGING_MODE            "IEEE"
-#elif defined(SWARM_RANGING_V1)
-#define     RANGING_MODE            "SR_V1"
-#elif defined(SWARM_RANGING_V2)
-#define     RANGING_MODE            "SR_V2"
-#elif defined(DYNAMIC_RANGING)
-#define     RANGING_MODE            "DSR"
-#elif defined(COMPENSATE_DYNAMIC_RANGING)
-#define     RANGING_MODE            "CDSR"
-#endif
-
+static Drone_Context_t *droneContext;
+static int droneContextCount = 0;
+static int16_t *droneContextIndex;                      // UWB_Address_t -> position in droneContext, -1 if not hosted
 #ifdef REAL_TIME_ENABLE
-int load_csv_to_memory(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        perror("open failed");
-        return -1;
-    }
-
-    char line[MAX_LINE];
-    total_rows = 0;
-
-    if (!fgets(line, sizeof(line), fp)) {
-        fclose(fp);
-        return 0;
-    }
-
-    while (fgets(line, sizeof(line), fp) && total_rows < MAX_ROWS) {
-        line[strcspn(line, "\r\n")] = 0;
-        csv_lines[total_rows] = strdup(line);
-        total_rows++;
-    }
-
-    fclose(fp);
-    return total_rows;
-}
-
-uint64_t get_csv_cell_ll(int n, int m) {
-    if (n < 0 || n >= total_rows) return 0;
-
-    char *line_copy = strdup(csv_lines[n]);
-    char *token = strtok(line_copy, DELIM);
-    int col = 0;
-    uint64_t result = 0;
-
-    while (token) {
-        if (col == m) {
-            result = atoll(token);
-            break;
-        }
-        token = strtok(NULL, DELIM);
-        col++;
-    }
-
-    free(line_copy);
-    return result;
-}
-
-void free_csv_memory() {
-    for (int i = 0; i < total_rows; i++) free(csv_lines[i]);
-    total_rows = 0;
-    csv_pos = 0;
-}
-
-uint64_t get_next_RxTimestamp(uint16_t RxAddress, uint64_t RxTimestamp) {
-    int matched = 0;
+static Trace_t flightLog;                               // shared by all drones hosted in this process
+static char launchTrace[MAX_LINE_LEN];                  // trace of the image attached from ./launch, empty without
+#endif
 
-    for (int i = csv_pos; i < total_rows; i++) {
-        uint16_t addr = (uint16_t)get_csv_cell_ll(i, 5); 
-        uint64_t time = get_csv_cell_ll(i, 6);         
 
-        if (!matched) {
-            if (addr == RxAddress && time == RxTimestamp) {
-                matched = 1;
-            }
-        } else {
-            if (addr == RxAddress) {
-                csv_pos = i; 
-                return time;
-            }
-        }
+Drone_Context_t *find_context(const char *address) {
+    int index = droneContextIndex[(uint16_t)strtoul(address, NULL, 10)];
+    if (index >= 0 && strcmp(droneContext[index].address, address) == 0) {
+        return &droneContext[index];
     }
-
-    csv_pos = total_rows;
-    return NULL_TIMESTAMP;
+    return NULL;
 }
-#endif
-
-void send_to_center(int center_socket, const char* address, const Ranging_Message_t *ranging_msg) {
-    Simu_Message_t simu_msg;
 
+/* simu_msg carries a ranging message generated in its payload */
+void send_to_center(int center_socket, const char* address, Simu_Message_t *simu_msg) {
     if(sizeof(Ranging_Message_t) > PAYLOAD_SIZE) {
         perror("Warning: Ranging_Message_t too large!\n");
     }
 
-    snprintf(simu_msg.srcAddress, sizeof(simu_msg.srcAddress), "%s", address);
-    memcpy(simu_msg.payload, ranging_msg, sizeof(Ranging_Message_t));
-    simu_msg.size = sizeof(Ranging_Message_t);
+    snprintf(simu_msg->srcAddress, sizeof(simu_msg->srcAddress), "%s", address);
+    snprintf(simu_msg->destAddress, sizeof(simu_msg->destAddress), "%s", CENTER_ADDRESS);
+    simu_msg->size = sizeof(Ranging_Message_t);
 
-    if (send(center_socket, &simu_msg, sizeof(Simu_Message_t), 0) < 0) {
+    if (send(center_socket, simu_msg, sizeof(Simu_Message_t), 0) < 0) {
         perror("Send failed");
     }
 }
 
-void response_to_center(int center_socket, const char* address) {
+void response_to_center(int center_socket, Drone_Context_t *context, Simu_Direction_t status, uint64_t deadline) {
     Simu_Message_t simu_msg;
 
-    snprintf(simu_msg.srcAddress, sizeof(simu_msg.srcAddress), "%s", address);
+    // a response with a deadline also reports how late the callback finished in paced replay
+    Line_Message_t report;
+    memset(&report, 0, sizeof(Line_Message_t));
+    report.address = context->id;
+    report.status = status;
+    report.deadline = deadline;
+    report.slack = deadline != 0 ? (int64_t)(deadline - get_monotonic_time()) : 0;
+
+    snprintf(simu_msg.srcAddress, sizeof(simu_msg.srcAddress), "%s", context->address);
+    snprintf(simu_msg.destAddress, sizeof(simu_msg.destAddress), "%s", CENTER_ADDRESS);
+    memcpy(simu_msg.payload, &report, sizeof(Line_Message_t));
     simu_msg.size = sizeof(Line_Message_t);
 
     if (send(center_socket, &simu_msg, sizeof(Simu_Message_t), 0) < 0) {
@@ -137,104 +61,21 @@ void response_to_center(int center_socket, const char* address) {
     }
 }
 
-void TxCallBack(int center_socket, dwTime_t timestamp) {
-    #if defined(CLASSIC_RANGING_MODE)
-        Ranging_Message_t ranging_msg;
-
-        generateRangingMessage(&ranging_msg);
-        Timestamp_Tuple_t curTimeTuple = {
-            .timestamp = timestamp,
-            .seqNumber = ranging_msg.header.msgSequence
-        };
-        updateTfBuffer(curTimeTuple);
-
-        send_to_center(center_socket, localAddress, &ranging_msg);
-        
-        // printf("Txcall, Txtimesatamp = %lu\n", timestamp.full);
-
-        // reset of TxTimestamp in other place
-    #elif defined(MODIFIED_RANGING_MODE)
-        Ranging_Message_t ranging_msg;
-
-        generateDSRMessage(&ranging_msg);
-        Timestamp_Tuple_t curTimeTuple = {
-            .timestamp = timestamp,
-            .seqNumber = ranging_msg.header.msgSequence
-        };
-        updateSendList(&rangingTableSet->sendList, curTimeTuple);
+void TxCallBack(int center_socket, Drone_Context_t *context, dwTime_t timestamp) {
+    Simu_Message_t simu_msg;
 
-        send_to_center(center_socket, localAddress, &ranging_msg);
+    // generated in place, no copy of the ranging message on the way to the center
+    node_tx(context, timestamp, (Ranging_Message_t*)simu_msg.payload);
+    send_to_center(center_socket, context->address, &simu_msg);
 
-        // printf("Txcall, Txtimesatamp = %lu\n", timestamp.full);
-    
-        // reset TxTimestamp after callback
-        TxTimestamp.full = 0;
-    #endif
+    // printf("Txcall, Txtimesatamp = %lu\n", timestamp.full);
 }
 
-void RxCallBack(int center_socket, Ranging_Message_t *rangingMessage, dwTime_t timestamp) {
-    int randnum = rand() % 10000;
-    if (randnum < (int)(PACKET_LOSS * 10000) || timestamp.full == 0) {
-        response_to_center(center_socket, localAddress);
-        return;
-    }
-
-    #if defined(CLASSIC_RANGING_MODE)
-        Ranging_Message_With_Timestamp_t rangingMessageWithTimestamp;
-        rangingMessageWithTimestamp.rangingMessage = *rangingMessage;
-        rangingMessageWithTimestamp.rxTime = timestamp;
-        
-        processRangingMessage(&rangingMessageWithTimestamp);
-
-        #ifdef REAL_TIME_ENABLE
-            uint64_t next_RxTimestamp = get_next_RxTimestamp((uint16_t)strtoul(localAddress, NULL, 10), timestamp.full);
-            uint64_t check_interval = ((next_RxTimestamp - timestamp.full + UWB_MAX_TIMESTAMP) % UWB_MAX_TIMESTAMP) / (CHECK_POINT + 1);
-            for(int i = 1; i <= CHECK_POINT; i++) {
-                uint64_t check_timestamp = (timestamp.full + check_interval * i) % UWB_MAX_TIMESTAMP;
-                uint16_t neighborAddress = rangingMessage->header.srcAddress;
-                int16_t distance = getDistance(neighborAddress);
-                DEBUG_PRINT("[local_%u <- neighbor_%u]: %s dist = %d, time = %llu\n", (uint16_t)strtoul(localAddress, NULL, 10), neighborAddress, RANGING_MODE, distance, check_timestamp);
-            }
-        #endif
-
-        response_to_center(center_socket, localAddress);
-
-        // printf("Rxcall, Rx timestamp = %lu\n", timestamp.full);
-
-        // reset of RxTimestamp in other place
-    #elif defined(MODIFIED_RANGING_MODE)
-        Ranging_Message_With_Additional_Info_t rangingMessageWithAdditionalInfo;
-        rangingMessageWithAdditionalInfo.rangingMessage = *rangingMessage;
-        rangingMessageWithAdditionalInfo.timestamp = timestamp;
-
-        processDSRMessage(&rangingMessageWithAdditionalInfo);
-
-        #ifdef REAL_TIME_ENABLE
-            uint16_t neighborAddress = rangingMessage->header.srcAddress;
-            uint64_t next_RxTimestamp = get_next_RxTimestamp((uint16_t)strtoul(localAddress, NULL, 10), timestamp.full);
-            if(next_RxTimestamp == NULL_TIMESTAMP) {
-                for(int i = 1; i <= CHECK_POINT; i++) {
-                    double distance = getCurDistance(neighborAddress, NULL_TIMESTAMP);
-                    DEBUG_PRINT("[local_%u <- neighbor_%u]: %s dist = %f, time = %llu\n", (uint16_t)strtoul(localAddress, NULL, 10), neighborAddress, RANGING_MODE, distance, timestamp.full);
-                }
-            }
-            else {
-                uint64_t check_interval = ((next_RxTimestamp - timestamp.full + UWB_MAX_TIMESTAMP) % UWB_MAX_TIMESTAMP) / (CHECK_POINT + 1);
-                for(int i = 1; i <= CHECK_POINT; i++) {
-                    uint64_t check_timestamp = (timestamp.full + check_interval * i) % UWB_MAX_TIMESTAMP;
-                    double distance = getCurDistance(neighborAddress, check_timestamp);
-                    DEBUG_PRINT("[local_%u <- neighbor_%u]: %s dist = %f, time = %llu\n", (uint16_t)strtoul(localAddress, NULL, 10), neighborAddress, RANGING_MODE, distance, check_timestamp);
-                }
-            }
-        #endif
-
-        response_to_center(center_socket, localAddress);
-
-        // printf("Rxcall, Rx timestamp = %lu\n", timestamp.full);
+void RxCallBack(int center_socket, Drone_Context_t *context, Ranging_Message_t *rangingMessage, dwTime_t timestamp) {
+    node_rx(context, rangingMessage, timestamp);
+    response_to_center(center_socket, context, RX, context->deadline);
 
-        // reset RxTimestamp after callback
-        RxTimestamp.full = 0;
-    #endif
+    // printf("Rxcall, Rx timestamp = %lu\n", timestamp.full);
 }
 
 void *receive_from_center(void *arg) {
@@ -242,7 +83,7 @@ void *receive_from_center(void *arg) {
     Simu_Message_t simu_msg;
 
     while(true) {
-        ssize_t bytes_received = recv(center_socket, &simu_msg, sizeof(Simu_Message_t), 0);
+        ssize_t bytes_received = recv(center_socket, &simu_msg, sizeof(Simu_Message_t), MSG_WAITALL);
 
         if(bytes_received <= 0) {
             printf("Disconnected from Control Center\n");
@@ -250,21 +91,35 @@ void *receive_from_center(void *arg) {
             break;
         }
 
+        // every message is tagged with the hosted drone it is meant for
+        Drone_Context_t *context = find_context(simu_msg.destAddress);
+        if(context == NULL) {
+            continue;
+        }
+
         // ignore the message from itself
-        if(strcmp(simu_msg.srcAddress, localAddress) != 0) {
+        if(strcmp(simu_msg.srcAddress, context->address) != 0) {
+            context_switch(context);
+
             // handle message of flightLog
             if(simu_msg.size == sizeof(Line_Message_t)) {
                 Line_Message_t *line_message = (Line_Message_t*)simu_msg.payload;
-                if(line_message->address == (uint16_t)strtoul(localAddress, NULL, 10)) {
+                if(line_message->address == context->id) {
                     // sender
+                    context->deadline = line_message->deadline;
+                    context->warmup = line_message->warmup;
                     if(line_message->status == TX) {
                         TxTimestamp.full = line_message->timestamp.full;
-                        TxCallBack(center_socket, TxTimestamp);
+                        TxCallBack(center_socket, context, TxTimestamp);
+                        // Tx reports only carry lateness and are not counted as responses
+                        if(context->deadline != 0) {
+                            response_to_center(center_socket, context, TX, context->deadline);
+                        }
                     }
                     // receiver
                     else if(line_message->status == RX) {
                         RxTimestamp.full = line_message->timestamp.full;
-                        response_to_center(center_socket, localAddress);
+                        response_to_center(center_socket, context, RX, 0);
                     }
                 }
             }
@@ -272,7 +127,7 @@ void *receive_from_center(void *arg) {
             // handle message of rangingMessage
             else if(simu_msg.size == sizeof(Ranging_Message_t)) {
                 Ranging_Message_t *ranging_msg = (Ranging_Message_t*)simu_msg.payload;
-                RxCallBack(center_socket, ranging_msg, RxTimestamp);
+                RxCallBack(center_socket, context, ranging_msg, RxTimestamp);
             }
             else {
                 printf("Received unknown message size: %zu\n", simu_msg.size);
@@ -283,32 +138,128 @@ void *receive_from_center(void *arg) {
     return NULL;
 }
 
+/* started by ./launch: attach its trace image, then wait until every drone process is set up and the center listens */
+int launch_ready(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror("shm_open launch control failed");
+        return -1;
+    }
+    Launch_Control_t *control = mmap(NULL, sizeof(Launch_Control_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (control == MAP_FAILED) {
+        perror("mmap launch control failed");
+        return -1;
+    }
+    if (control->magic != LAUNCH_MAGIC) {
+        fprintf(stderr, "%s is not a launch control block\n", name);
+        munmap(control, sizeof(Launch_Control_t));
+        return -1;
+    }
+
+    #ifdef REAL_TIME_ENABLE
+        if (*control->image && trace_attach(&flightLog, control->image) > 0) {
+            snprintf(launchTrace, sizeof(launchTrace), "%s", control->trace);
+        }
+    #endif
+    pthread_barrier_wait(&control->ready);
+    munmap(control, sizeof(Launch_Control_t));
+    return 0;
+}
+
+/* join for the first of count addresses that fit in one payload, more=1 if the rest follow in further joins; returns how many it holds */
+int pack_join(Simu_Message_t *join_msg, int session_id, char *const *address, int count) {
+    char header[PAYLOAD_SIZE];
+    int header_len = snprintf(header, sizeof(header), "join session=%d mode=%s ranging_size=%zu", session_id, RANGING_MODE, sizeof(Ranging_Message_t));
+    // room left for the list, counting " more=1 addresses=" and the terminator
+    int room = PAYLOAD_SIZE - header_len - (int)strlen(" more=1 addresses=") - 1;
+    char list[PAYLOAD_SIZE];
+    int used = 0;
+    int packed = 0;
+    while (packed < count) {
+        int len = snprintf(list + used, sizeof(list) - used, "%s%s", packed > 0 ? "," : "", address[packed]);
+        if (used + len > room) {
+            list[used] = '\0';
+            break;
+        }
+        used += len;
+        packed++;
+    }
+    snprintf(join_msg->payload, PAYLOAD_SIZE, "%s%s addresses=%s", header, packed < count ? " more=1" : "", list);
+    join_msg->size = strlen(join_msg->payload) + 1;
+    return packed;
+}
+
+/* reply of the center to a join: "ok session=<id> trace=<path> [log=<path>]" */
+bool apply_join_reply(char *payload, char *trace, size_t trace_size, char *log, size_t log_size) {
+    char *saveptr;
+    char *token = strtok_r(payload, " ", &saveptr);
+    if (token == NULL || strcmp(token, "ok") != 0) {
+        printf("Join rejected:%s%s\n", saveptr && *saveptr ? " " : "", saveptr ? saveptr : "");
+        return false;
+    }
+
+    while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
+        char *value = strchr(token, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        if (strcmp(token, "trace") == 0) {
+            snprintf(trace, trace_size, "%s", value);
+        }
+        else if (strcmp(token, "log") == 0) {
+            snprintf(log, log_size, "%s", value);
+        }
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: ./drone <localAddress>\n");
+    int session_id = DEFAULT_SESSION;
+    const char *launch_name = NULL;
+    static struct option long_options[] = {
+        {"session", required_argument, NULL, 's'},
+        {"launch", required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:", long_options, NULL)) != -1) {
+        if (opt == 's') {
+            session_id = atoi(optarg);
+        }
+        else if (opt == 'l') {
+            launch_name = optarg;
+        }
+        else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc) {
+        printf("Usage: ./drone [--session <id>] <localAddress> [<localAddress> ...]\n");
         return 1;
     }
 
     const char *center_ip = CENTER_IP;
-    localAddress = argv[1];
-
-    lastTxTimestamp.full = 0;
-    lastRxTimestamp.full = 0;
-    TxTimestamp.full = 0;
-    RxTimestamp.full = 0;
 
-    #ifdef REAL_TIME_ENABLE
-        if (load_csv_to_memory("data/simulation_dep.csv") <= 0) {
-            printf("Failed to load CSV\n");
-            return 1;
-        }
-    #endif
+    // one ranging state per hosted address
+    droneContext = calloc(argc - optind, sizeof(Drone_Context_t));
+    droneContextIndex = malloc(ADDRESS_INDEX_SIZE * sizeof(int16_t));
+    memset(droneContextIndex, -1, ADDRESS_INDEX_SIZE * sizeof(int16_t));
+    for (int i = optind; i < argc; i++) {
+        droneContextIndex[(uint16_t)strtoul(argv[i], NULL, 10)] = (int16_t)droneContextCount;
+        context_init(&droneContext[droneContextCount++], argv[i]);
+    }
+    Simu_Message_t register_msg;
+    memset(&register_msg, 0, sizeof(Simu_Message_t));
+    snprintf(register_msg.srcAddress, sizeof(register_msg.srcAddress), "%s", argv[optind]);
+    snprintf(register_msg.destAddress, sizeof(register_msg.destAddress), "%s", CENTER_ADDRESS);
 
-    #if defined(CLASSIC_RANGING_MODE)
-        rangingTableSetInit(&rangingTableSet);
-    #elif defined(MODIFIED_RANGING_MODE)
-        rangingTableSetInit();
-    #endif
+    if (launch_name != NULL && launch_ready(launch_name) < 0) {
+        return 1;
+    }
 
     int center_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (center_socket < 0) {
@@ -333,8 +284,67 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    // Send drone ID first
-    send(center_socket, localAddress, strlen(localAddress), 0);
+    opt = 1;
+    setsockopt(center_socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    // Join the session with every hosted drone ID, the center answers the last join before the first line
+    for (int i = optind; i < argc; ) {
+        int packed = pack_join(&register_msg, session_id, argv + i, argc - i);
+        if (packed == 0) {
+            printf("Address %s does not fit in a join message\n", argv[i]);
+            close(center_socket);
+            return 1;
+        }
+        send(center_socket, &register_msg, sizeof(Simu_Message_t), 0);
+        i += packed;
+    }
+
+    Simu_Message_t reply_msg;
+    char trace[MAX_LINE_LEN] = FILE_NAME;
+    static char log[MAX_LINE_LEN];
+    if (recv(center_socket, &reply_msg, sizeof(Simu_Message_t), MSG_WAITALL) <= 0) {
+        printf("Disconnected from Control Center\n");
+        close(center_socket);
+        return -1;
+    }
+    reply_msg.payload[PAYLOAD_SIZE - 1] = '\0';
+    if (!apply_join_reply(reply_msg.payload, trace, sizeof(trace), log, sizeof(log))) {
+        close(center_socket);
+        return 1;
+    }
+
+    // concurrent sessions of one mode must not share a log, e.g. ./data/log/compensate_s3.txt
+    if (*log == '\0' && session_id != DEFAULT_SESSION) {
+        snprintf(log, sizeof(log), "%.*s_s%d.txt", (int)(strlen(LOG_FILE_NAME) - 4), LOG_FILE_NAME, session_id);
+    }
+    if (*log != '\0') {
+        logFileName = log;
+    }
+
+    #ifdef TELEMETRY_ENABLE
+        telemetry_open(TELEMETRY_NAME);
+    #endif
+
+    // per-link counters next to the distance log, e.g. ./data/log/compensate_links_1.csv
+    if (LINK_STATS_PERIOD > 0) {
+        char link_stats_name[MAX_LINE_LEN];
+        snprintf(link_stats_name, sizeof(link_stats_name), "%.*s_links_%s.csv", (int)(strlen(logFileName) - 4), logFileName, droneContext[0].address);
+        if (link_stats_open(link_stats_name, droneContext, droneContextCount, LINK_STATS_PERIOD * 1000000ULL) == 0) {
+            atexit(link_stats_close);
+        }
+    }
+
+    #ifdef REAL_TIME_ENABLE
+        // the image of ./launch stands in for the trace it was loaded from
+        if (flightLog.image != NULL && strcmp(trace, launchTrace) != 0) {
+            trace_free(&flightLog);
+        }
+        if (flightLog.image == NULL && trace_load(&flightLog, trace) <= 0) {
+            printf("Failed to load CSV\n");
+            return 1;
+        }
+        nodeTrace = &flightLog;
+    #endif
 
     // Receive thread
     pthread_t receive_thread;
@@ -344,14 +354,14 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    printf("Node %s connected to center\n", localAddress);
+    printf("Node %s connected to session %d\n", strrchr(register_msg.payload, '=') + 1, session_id);
 
     pthread_join(receive_thread, NULL);
     close(center_socket);
 
     #ifdef REAL_TIME_ENABLE
-        free_csv_memory();
+        trace_free(&flightLog);
     #endif
 
     return 0;
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <semaphore.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -24,15 +25,18 @@
 
 
 #define     ADDR_SIZE               20
+#define     BROADCAST_ADDRESS       "BROADCAST"
 #define     CENTER_ADDRESS          "CENTER"
 #define     CENTER_IP               "127.0.0.1"
 #define     CENTER_PORT             8520
 #define     MAX_LINE_LEN            256
 #define     MESSAGE_SIZE            512
-#define     PAYLOAD_SIZE            MESSAGE_SIZE - ADDR_SIZE - sizeof(size_t)
+#define     PAYLOAD_SIZE            MESSAGE_SIZE - 2 * ADDR_SIZE - sizeof(size_t)
+#define     DEFAULT_SESSION         0       // session served by a single-run center, joined by drones without --session
+#define     ADDRESS_INDEX_SIZE      65536   // entries of a direct-mapped UWB_Address_t -> node index
 
 
-const char *FILE_NAME = "./data/simulation_dep.csv";
+#define     FILE_NAME               "./data/simulation_dep.csv"
 
 
 typedef enum {
@@ -42,25 +46,29 @@ typedef enum {
 
 typedef struct {
     uint16_t address;
+    bool warmup;            // the line precedes the replay window, outputs of its callbacks are marked [warmup]
     Simu_Direction_t status;
     dwTime_t timestamp;
+    uint64_t deadline;      // CLOCK_MONOTONIC time (ns) of the next trace event in paced replay, 0 when unpaced
+    int64_t slack;          // reported back by drones: deadline minus callback completion time (ns)
 } Line_Message_t;
 
 typedef struct {
     char srcAddress[ADDR_SIZE];
+    char destAddress[ADDR_SIZE];
     char payload[PAYLOAD_SIZE];
     size_t size;
 } Simu_Message_t;           // message sent between center and drones
 
 typedef struct {
-    int socket;
+    int socket;             // shared by all drones hosted in the same process
     char address[ADDR_SIZE];
 } Drone_Node_t;             // drone
 
 typedef struct {
-    Drone_Node_t node[NODES_NUM];
+    Drone_Node_t *node;
     int count;
-    pthread_mutex_t mutex;
+    int capacity;           // drones expected by the session
 } Drone_Node_Set_t;         // set of drones
 
 #endif
\ No newline at end of file
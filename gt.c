@@ -0,0 +1,228 @@
+#include <fcntl.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gt.h"
+
+
+static size_t gt_address_size(uint32_t body_count) {
+    return (body_count * sizeof(uint16_t) + 7) & ~(size_t)7;
+}
+
+bool gt_probe(const char *filename) {
+    char magic[4];
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    bool found = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, GT_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return found;
+}
+
+static int gt_frame_count(const Gt_Store_t *store) {
+    if (store->blockCount == 0) {
+        return 0;
+    }
+    const Gt_Block_t *last = &store->block[store->blockCount - 1];
+    return (int)(last->firstFrame + last->frameCount);
+}
+
+static const uint8_t *gt_frame(const Gt_Store_t *store, int frame) {
+    int lo = 0, hi = store->blockCount - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (store->block[mid].firstFrame <= (uint32_t)frame) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    const Gt_Block_t *block = &store->block[lo];
+    return store->data + block->offset + (size_t)(frame - block->firstFrame) * store->stride;
+}
+
+uint64_t gt_frame_time(const Gt_Store_t *store, int frame) {
+    uint64_t system_time;
+    memcpy(&system_time, gt_frame(store, frame), sizeof(system_time));
+    return system_time;
+}
+
+/* first frame of the whole store at or after systemTime: the block index, then the frames of one block */
+static int gt_lower_bound_all(const Gt_Store_t *store, uint64_t systemTime) {
+    int lo = 0, hi = store->blockCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (store->block[mid].lastTime < systemTime) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo == store->blockCount) {
+        return gt_frame_count(store);
+    }
+
+    const Gt_Block_t *block = &store->block[lo];
+    uint32_t first = 0, last = block->frameCount;
+    while (first < last) {
+        uint32_t mid = first + (last - first) / 2;
+        uint64_t system_time;
+        memcpy(&system_time, store->data + block->offset + mid * store->stride, sizeof(system_time));
+        if (system_time < systemTime) {
+            first = mid + 1;
+        }
+        else {
+            last = mid;
+        }
+    }
+    return (int)(block->firstFrame + first);
+}
+
+/* frames within [leftbound, rightbound] are used, rightbound 0 keeps everything */
+int gt_open(Gt_Store_t *store, const char *filename, uint64_t leftbound, uint64_t rightbound) {
+    memset(store, 0, sizeof(Gt_Store_t));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open ground truth");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)(sizeof(Gt_Header_t) + sizeof(Gt_Footer_t))) {
+        fprintf(stderr, "Truncated ground truth %s\n", filename);
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map ground truth");
+        return -1;
+    }
+    store->data = data;
+    store->size = st.st_size;
+
+    const Gt_Header_t *header = data;
+    const Gt_Footer_t *footer = (const Gt_Footer_t *)(store->data + store->size - sizeof(Gt_Footer_t));
+    size_t frames_offset = sizeof(Gt_Header_t) + gt_address_size(header->bodyCount);
+    if (memcmp(header->magic, GT_MAGIC, 4) != 0 || header->version != GT_VERSION || memcmp(footer->magic, GT_INDEX_MAGIC, 4) != 0
+        || footer->indexOffset < frames_offset || footer->indexOffset % 8 != 0
+        || footer->indexOffset + (uint64_t)footer->blockCount * sizeof(Gt_Block_t) > store->size - sizeof(Gt_Footer_t)) {
+        fprintf(stderr, "Invalid ground truth %s\n", filename);
+        gt_close(store);
+        return -1;
+    }
+    store->bodyCount = header->bodyCount;
+    store->address = (const uint16_t *)(store->data + sizeof(Gt_Header_t));
+    store->stride = sizeof(uint64_t) + store->bodyCount * 3 * sizeof(float);
+    store->block = (const Gt_Block_t *)(store->data + footer->indexOffset);
+    store->blockCount = footer->blockCount;
+
+    uint32_t frame = 0;
+    for (int i = 0; i < store->blockCount; i++) {
+        const Gt_Block_t *block = &store->block[i];
+        if (block->firstFrame != frame || block->offset < frames_offset
+            || block->offset + (uint64_t)block->frameCount * store->stride > footer->indexOffset) {
+            fprintf(stderr, "Invalid block %d of ground truth %s\n", i, filename);
+            gt_close(store);
+            return -1;
+        }
+        frame += block->frameCount;
+    }
+
+    store->frameBegin = gt_lower_bound_all(store, leftbound);
+    store->frameEnd = rightbound != 0 ? gt_lower_bound_all(store, rightbound + 1) : gt_frame_count(store);
+    return store->frameEnd - store->frameBegin;
+}
+
+void gt_close(Gt_Store_t *store) {
+    if (store->data != NULL) {
+        munmap(store->data, store->size);
+    }
+    memset(store, 0, sizeof(Gt_Store_t));
+}
+
+/* first frame at or after systemTime, frameEnd if none */
+int gt_lower_bound(const Gt_Store_t *store, uint64_t systemTime) {
+    int frame = gt_lower_bound_all(store, systemTime);
+    if (frame < store->frameBegin) {
+        return store->frameBegin;
+    }
+    return frame < store->frameEnd ? frame : store->frameEnd;
+}
+
+static int gt_body(const Gt_Store_t *store, uint16_t address) {
+    int lo = 0, hi = (int)store->bodyCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (store->address[mid] < address) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo < (int)store->bodyCount && store->address[lo] == address ? lo : -1;
+}
+
+static void gt_position(const Gt_Store_t *store, int frame, int body, double position[3]) {
+    float value[3];
+    memcpy(value, gt_frame(store, frame) + sizeof(uint64_t) + body * sizeof(value), sizeof(value));
+    for (int i = 0; i < 3; i++) {
+        position[i] = value[i];
+    }
+}
+
+/* distance in cm between two bodies, positions interpolated linearly between the frames around systemTime */
+bool gt_distance(const Gt_Store_t *store, uint16_t local, uint16_t neighbor, uint64_t systemTime, double *distance) {
+    int a = gt_body(store, local);
+    int b = gt_body(store, neighbor);
+    int next = gt_lower_bound(store, systemTime);
+    if (a < 0 || b < 0 || next == store->frameEnd) {
+        return false;
+    }
+
+    uint64_t next_time = gt_frame_time(store, next);
+    int previous = next;
+    double weight = 0;
+    if (next_time != systemTime) {
+        if (next == store->frameBegin) {
+            return false;
+        }
+        previous = next - 1;
+        uint64_t previous_time = gt_frame_time(store, previous);
+        weight = (double)(systemTime - previous_time) / (double)(next_time - previous_time);
+    }
+
+    double a0[3], a1[3], b0[3], b1[3];
+    gt_position(store, previous, a, a0);
+    gt_position(store, next, a, a1);
+    gt_position(store, previous, b, b0);
+    gt_position(store, next, b, b1);
+
+    double square = 0;
+    for (int i = 0; i < 3; i++) {
+        double delta = (a0[i] + weight * (a1[i] - a0[i])) - (b0[i] + weight * (b1[i] - b0[i]));
+        square += delta * delta;
+    }
+    *distance = sqrt(square) * 100;      // m -> cm, as in vicon.txt
+    return true;
+}
+
+/* distances at count instants, -1 where the store has no frames around the instant; returns the number resolved */
+int gt_distance_batch(const Gt_Store_t *store, uint16_t local, uint16_t neighbor, const uint64_t *systemTime, int count, double *distance) {
+    int resolved = 0;
+    for (int i = 0; i < count; i++) {
+        if (gt_distance(store, local, neighbor, systemTime[i], &distance[i])) {
+            resolved++;
+        }
+        else {
+            distance[i] = -1;
+        }
+    }
+    return resolved;
+}
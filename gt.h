@@ -0,0 +1,56 @@
+#ifndef GT_H
+#define GT_H
+
+
+#include "support.h"
+
+
+#define     GT_MAGIC                "DGT1"
+#define     GT_INDEX_MAGIC          "DGTI"
+#define     GT_VERSION              1
+#define     GT_BLOCK_FRAMES         256     // frames per block of the index written by script/ground_truth.py
+
+
+typedef struct {
+    char magic[4];              // GT_MAGIC
+    uint32_t version;
+    uint32_t bodyCount;
+    uint32_t blockFrames;
+    uint64_t reserved[2];
+} Gt_Header_t;                  // followed by uint16_t address[bodyCount] sorted ascending, padded to 8 bytes
+
+typedef struct {
+    uint64_t firstTime;
+    uint64_t lastTime;
+    uint64_t offset;            // file offset of the first frame of the block
+    uint32_t firstFrame;
+    uint32_t frameCount;
+} Gt_Block_t;                   // frames are uint64_t system_time followed by float position[bodyCount][3] in m
+
+typedef struct {
+    uint64_t indexOffset;       // file offset of Gt_Block_t[blockCount]
+    uint32_t blockCount;
+    char magic[4];              // GT_INDEX_MAGIC
+} Gt_Footer_t;                  // last bytes of the file
+
+typedef struct {
+    uint8_t *data;              // whole file, mapped read-only
+    size_t size;
+    uint32_t bodyCount;
+    const uint16_t *address;
+    size_t stride;              // bytes per frame
+    const Gt_Block_t *block;
+    int blockCount;
+    int frameBegin;             // frames within [leftbound, rightbound] of gt_open
+    int frameEnd;
+} Gt_Store_t;                   // ground-truth body positions indexed by system_time
+
+
+bool gt_probe(const char *filename);
+int gt_open(Gt_Store_t *store, const char *filename, uint64_t leftbound, uint64_t rightbound);
+void gt_close(Gt_Store_t *store);
+uint64_t gt_frame_time(const Gt_Store_t *store, int frame);
+int gt_lower_bound(const Gt_Store_t *store, uint64_t systemTime);
+bool gt_distance(const Gt_Store_t *store, uint16_t local, uint16_t neighbor, uint64_t systemTime, double *distance);
+int gt_distance_batch(const Gt_Store_t *store, uint16_t local, uint16_t neighbor, const uint64_t *systemTime, int count, double *distance);
+#endif
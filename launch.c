@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "launch.h"
+#include "trace.h"
+
+
+#define     LAUNCH_KILL_GRACE       2       // s between SIGTERM and SIGKILL of the process group of a failed run
+#define     LAUNCH_PROBE_INTERVAL   1000000 // ns between two connection attempts while the center starts
+
+typedef struct {
+    int cpu;
+    int package;
+    int core;
+    int sibling;                            // hardware threads of the same core listed before this one
+} Launch_Cpu_t;
+
+typedef struct {
+    pid_t pid;
+    int cpu;                                // -1 when not pinned
+    int first;                              // hosted addresses [first, last), the center hosts none
+    int last;
+    bool running;
+    int status;
+    struct rusage usage;
+} Launch_Child_t;
+
+
+static Launch_Control_t *control = NULL;
+static char controlName[64];
+static char imageName[64];
+static pid_t processGroup = 0;
+static _Atomic uint64_t readyTime = 0;      // CLOCK_MONOTONIC time the barrier was passed, 0 before
+static volatile sig_atomic_t stopSignal = 0;
+static volatile sig_atomic_t alarmFired = 0;
+
+
+static void usage() {
+    printf("Usage: ./launch [-p processes] [-n] [-T timeout_s] [-R window_start:window_end [-u warmup_ms]] [time_dilation]\n");
+    printf("  starts ./center and the drones of %s, NODES_NUM = %d\n", FILE_NAME, NODES_NUM);
+    printf("  -p  drone processes, default is one per CPU left to the drones\n");
+    printf("  -n  do not pin the processes to CPUs\n");
+    printf("  -T  stop the run after this many seconds, 0 waits for it to finish\n");
+    printf("  -R, -u and time_dilation are passed to ./center\n");
+}
+
+static void on_signal(int signal) {
+    if (signal == SIGALRM) {
+        alarmFired = 1;
+    }
+    else {
+        stopSignal = signal;
+    }
+}
+
+static int read_topology(int cpu, const char *name) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *fp = fopen(path, "r");
+    int value = -1;
+    if (fp) {
+        if (fscanf(fp, "%d", &value) != 1) {
+            value = -1;
+        }
+        fclose(fp);
+    }
+    return value;
+}
+
+static int cpu_compare(const void *a, const void *b) {
+    const Launch_Cpu_t *x = a, *y = b;
+    if (x->sibling != y->sibling) {
+        return x->sibling - y->sibling;
+    }
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    return x->cpu - y->cpu;
+}
+
+/* CPUs this process may run on, one hardware thread of every physical core first and their SMT siblings last */
+static int cpu_order(Launch_Cpu_t **order) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+    *order = malloc(CPU_SETSIZE * sizeof(Launch_Cpu_t));
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        Launch_Cpu_t *entry = &(*order)[count];
+        entry->cpu = cpu;
+        entry->package = read_topology(cpu, "physical_package_id");
+        entry->core = read_topology(cpu, "core_id");
+        entry->sibling = 0;
+        for (int i = 0; i < count; i++) {
+            if (entry->core >= 0 && (*order)[i].package == entry->package && (*order)[i].core == entry->core) {
+                entry->sibling++;
+            }
+        }
+        count++;
+    }
+    qsort(*order, count, sizeof(Launch_Cpu_t), cpu_compare);
+    return count;
+}
+
+/* every address that transmits or receives in the trace, in ascending order */
+static int trace_addresses(const Trace_t *trace, uint16_t **address) {
+    bool *seen = calloc(ADDRESS_INDEX_SIZE, sizeof(bool));
+    for (int i = 0; i < trace->lineCount; i++) {
+        seen[trace->line[i].srcAddress] = true;
+    }
+    for (int i = 0; i < trace->rxTotal; i++) {
+        seen[trace->rx[i].address] = true;
+    }
+    seen[0] = false;
+
+    int count = 0;
+    *address = malloc(ADDRESS_INDEX_SIZE * sizeof(uint16_t));
+    for (int a = 1; a < ADDRESS_INDEX_SIZE; a++) {
+        if (seen[a]) {
+            (*address)[count++] = (uint16_t)a;
+        }
+    }
+    free(seen);
+    return count;
+}
+
+static int control_open(int processes) {
+    snprintf(controlName, sizeof(controlName), "%s_%d", LAUNCH_NAME, (int)getpid());
+    int fd = shm_open(controlName, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("shm_open launch control failed");
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(Launch_Control_t)) < 0) {
+        perror("ftruncate launch control failed");
+        close(fd);
+        shm_unlink(controlName);
+        return -1;
+    }
+    control = mmap(NULL, sizeof(Launch_Control_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (control == MAP_FAILED) {
+        perror("mmap launch control failed");
+        control = NULL;
+        shm_unlink(controlName);
+        return -1;
+    }
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    int result = pthread_barrier_init(&control->ready, &attr, processes + 1);
+    pthread_barrierattr_destroy(&attr);
+    if (result != 0) {
+        fprintf(stderr, "pthread_barrier_init failed: %s\n", strerror(result));
+        return -1;
+    }
+    control->processes = processes;
+    snprintf(control->trace, sizeof(control->trace), "%s", FILE_NAME);
+    snprintf(control->image, sizeof(control->image), "%s", imageName);
+    control->magic = LAUNCH_MAGIC;
+    return 0;
+}
+
+/* the segments are only needed until every drone has attached them */
+static void control_unlink() {
+    if (*controlName) {
+        shm_unlink(controlName);
+    }
+    if (*imageName) {
+        shm_unlink(imageName);
+    }
+}
+
+/* the center accepts once it listens, the probe connection is closed before it sends anything */
+static bool center_listening() {
+    int probe = socket(AF_INET, SOCK_STREAM, 0);
+    if (probe < 0) {
+        return false;
+    }
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CENTER_PORT)
+    };
+    inet_pton(AF_INET, CENTER_IP, &address.sin_addr);
+    bool listening = connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0;
+    close(probe);
+    return listening;
+}
+
+/* completes the barrier for the launcher; a run that fails before it is killed and never passes */
+static void *wait_ready(void *arg) {
+    (void)arg;
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = LAUNCH_PROBE_INTERVAL};
+    while (!center_listening()) {
+        nanosleep(&interval, NULL);
+    }
+    pthread_barrier_wait(&control->ready);
+    atomic_store(&readyTime, get_monotonic_time());
+    control_unlink();
+    return NULL;
+}
+
+/* child side of a fork: dies with the launcher, joins the run's process group, runs pinned */
+static void child_exec(pid_t launcher, int cpu, char **argv) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != launcher) {
+        _exit(127);
+    }
+    setpgid(0, processGroup);
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            perror("sched_setaffinity failed");
+        }
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+    execv(argv[0], argv);
+    perror(argv[0]);
+    _exit(127);
+}
+
+static pid_t spawn(pid_t launcher, Launch_Child_t *child, char **argv) {
+    fflush(NULL);
+    child->pid = fork();
+    if (child->pid < 0) {
+        perror("fork failed");
+        return -1;
+    }
+    if (child->pid == 0) {
+        child_exec(launcher, child->cpu, argv);
+    }
+    // set on both sides of the fork, whichever runs first
+    if (processGroup == 0) {
+        processGroup = child->pid;
+    }
+    setpgid(child->pid, processGroup);
+    child->running = true;
+    return child->pid;
+}
+
+static void terminate(int signal) {
+    if (processGroup > 0) {
+        kill(-processGroup, signal);
+    }
+}
+
+static void report(const Launch_Child_t *child, int count, const uint16_t *address, uint64_t startTime, uint64_t endTime) {
+    printf("%-8s %8s %4s %-13s %-12s %9s %9s %11s\n", "process", "pid", "cpu", "drones", "status", "user (s)", "sys (s)", "maxrss (kB)");
+    for (int i = 0; i < count; i++) {
+        char drones[32] = "-";
+        if (i > 0) {
+            snprintf(drones, sizeof(drones), "%u-%u (%d)", address[child[i].first], address[child[i].last - 1], child[i].last - child[i].first);
+        }
+        char status[32] = "running";
+        if (!child[i].running && WIFEXITED(child[i].status)) {
+            snprintf(status, sizeof(status), "exit %d", WEXITSTATUS(child[i].status));
+        }
+        else if (!child[i].running && WIFSIGNALED(child[i].status)) {
+            snprintf(status, sizeof(status), "signal %d", WTERMSIG(child[i].status));
+        }
+        char cpu[8] = "-";
+        if (child[i].cpu >= 0) {
+            snprintf(cpu, sizeof(cpu), "%d", child[i].cpu);
+        }
+        printf("%-8s %8d %4s %-13s %-12s %9.3f %9.3f %11ld\n", i == 0 ? "center" : "drone", (int)child[i].pid, cpu, drones, status,
+               child[i].usage.ru_utime.tv_sec + child[i].usage.ru_utime.tv_usec / 1e6,
+               child[i].usage.ru_stime.tv_sec + child[i].usage.ru_stime.tv_usec / 1e6, child[i].usage.ru_maxrss);
+    }
+
+    uint64_t ready = atomic_load(&readyTime);
+    if (ready != 0) {
+        printf("Startup: %d drone processes ready %.1f ms after launch, run took %.3f s\n", count - 1, (ready - startTime) / 1e6, (endTime - ready) / 1e9);
+    }
+    else {
+        printf("Startup: the drones never became ready\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int processes = 0;
+    bool pin = true;
+    unsigned int timeout = 0;
+    char *center_argv[16] = {"./center", "-w", "1"};
+    int center_argc = 3;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:nT:R:u:h")) != -1) {
+        switch (opt) {
+            case 'p': processes = atoi(optarg); break;
+            case 'n': pin = false; break;
+            case 'T': timeout = (unsigned int)atoi(optarg); break;
+            case 'R':
+            case 'u':
+                center_argv[center_argc++] = opt == 'R' ? "-R" : "-u";
+                center_argv[center_argc++] = optarg;
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        center_argv[center_argc++] = argv[optind];
+    }
+    center_argv[center_argc] = NULL;
+    uint64_t start_time = get_monotonic_time();
+
+    // the drones of the run are the addresses of the trace the center replays
+    Trace_t trace;
+    if (trace_load(&trace, FILE_NAME) <= 0) {
+        fprintf(stderr, "Failed to load %s\n", FILE_NAME);
+        return 1;
+    }
+    uint16_t *address;
+    int address_count = trace_addresses(&trace, &address);
+    if (address_count != NODES_NUM) {
+        fprintf(stderr, "%s has %d drones, but NODES_NUM = %d\n", FILE_NAME, address_count, NODES_NUM);
+        trace_free(&trace);
+        return 1;
+    }
+    #ifdef REAL_TIME_ENABLE
+        // every drone process maps this copy instead of parsing the trace
+        snprintf(imageName, sizeof(imageName), "%s_%d_trace", LAUNCH_NAME, (int)getpid());
+        if (trace_share(&trace, imageName) < 0) {
+            trace_free(&trace);
+            return 1;
+        }
+    #endif
+    trace_free(&trace);
+
+    Launch_Cpu_t *cpu;
+    int cpu_count = cpu_order(&cpu);
+    if (cpu_count <= 0) {
+        control_unlink();
+        return 1;
+    }
+    if (processes <= 0) {
+        processes = cpu_count > 1 ? cpu_count - 1 : 1;
+    }
+    if (processes > address_count) {
+        processes = address_count;
+    }
+    if (control_open(processes) < 0) {
+        control_unlink();
+        return 1;
+    }
+
+    struct sigaction action = {.sa_handler = on_signal};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+
+    // the center gets the first CPU, drone processes take the others round-robin
+    pid_t launcher = getpid();
+    Launch_Child_t *child = calloc(processes + 1, sizeof(Launch_Child_t));
+    child[0].cpu = pin ? cpu[0].cpu : -1;
+    int started = 0;
+    bool failed = spawn(launcher, &child[0], center_argv) < 0;
+    started += !failed;
+
+    char name_arg[] = "--launch";
+    char **drone_argv = malloc((address_count + 4) * sizeof(char *));
+    char (*address_text)[8] = malloc(address_count * sizeof(*address_text));
+    for (int i = 0; i < address_count; i++) {
+        snprintf(address_text[i], sizeof(address_text[i]), "%u", address[i]);
+    }
+    for (int i = 1; i <= processes && !failed; i++) {
+        child[i].first = (i - 1) * address_count / processes;
+        child[i].last = i * address_count / processes;
+        child[i].cpu = pin ? cpu[cpu_count > 1 ? 1 + (i - 1) % (cpu_count - 1) : 0].cpu : -1;
+        int argc_drone = 0;
+        drone_argv[argc_drone++] = "./drone";
+        drone_argv[argc_drone++] = name_arg;
+        drone_argv[argc_drone++] = controlName;
+        for (int j = child[i].first; j < child[i].last; j++) {
+            drone_argv[argc_drone++] = address_text[j];
+        }
+        drone_argv[argc_drone] = NULL;
+        failed = spawn(launcher, &child[i], drone_argv) < 0;
+        started += !failed;
+    }
+    free(drone_argv);
+
+    pthread_t ready_thread;
+    if (!failed && pthread_create(&ready_thread, NULL, wait_ready, NULL) != 0) {
+        perror("Failed to create ready thread");
+        failed = true;
+    }
+    else if (!failed) {
+        pthread_detach(ready_thread);
+    }
+    if (timeout > 0) {
+        alarm(timeout);
+    }
+
+    // a process that fails takes the whole run down, so no drone waits for a center that is gone or vice versa
+    bool terminating = false;
+    int running = started;
+    while (running > 0) {
+        if (!terminating && (failed || stopSignal || alarmFired)) {
+            if (stopSignal) {
+                fprintf(stderr, "Launch: stopped by signal %d\n", (int)stopSignal);
+            }
+            else if (alarmFired) {
+                fprintf(stderr, "Launch: timeout after %u s\n", timeout);
+            }
+            terminate(SIGTERM);
+            terminating = true;
+            alarmFired = 0;
+            alarm(LAUNCH_KILL_GRACE);
+        }
+        else if (terminating && alarmFired) {
+            terminate(SIGKILL);
+            alarmFired = 0;
+        }
+
+        int status;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("wait4 failed");
+            break;
+        }
+        for (int i = 0; i <= processes; i++) {
+            if (child[i].pid == pid && child[i].running) {
+                child[i].running = false;
+                child[i].status = status;
+                child[i].usage = usage;
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    failed = true;
+                }
+            }
+        }
+    }
+    alarm(0);
+    uint64_t end_time = get_monotonic_time();
+
+    // nothing of the run outlives the launcher
+    terminate(SIGKILL);
+    control_unlink();
+
+    report(child, started, address, start_time, end_time);
+    bool success = !failed && !terminating && started == processes + 1;
+    free(child);
+    free(address);
+    free(address_text);
+    free(cpu);
+    return success ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+
+#include "frame.h"
+
+
+#define     LAUNCH_MAGIC            0x484e4c44      // "DLNH"
+
+
+/*
+ * Control block of ./launch, /dev/shm<LAUNCH_NAME>_<pid>. Drone processes started with --launch <name> attach the
+ * trace image named here instead of parsing the trace, then wait on `ready` together with the launcher, which passes
+ * it once the center listens. Drones join only after the barrier, so the center dispatches the first line to a swarm
+ * that is completely set up.
+ */
+typedef struct {
+    uint32_t magic;                                 // written last by the launcher
+    int32_t processes;                              // drone processes, the barrier also counts the launcher
+    pthread_barrier_t ready;                        // process-shared
+    char trace[MAX_LINE_LEN];                       // trace the image was loaded from, as the center names it
+    char image[MAX_LINE_LEN];                       // shm name of the image, empty when drones load the trace themselves
+} Launch_Control_t;
+#endif
@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include "replay.h"
+#include "libreplay.h"
+
+
+struct Libreplay {
+    Trace_t trace;
+    uint64_t windowStart;
+    Trace_Schedule_t schedule;
+    Gt_Store_t store;
+    bool scheduled;                 // schedule loaded from vicon.txt
+    bool stored;                    // store opened from vicon.gt
+};
+
+static Libreplay_Result_t *activeResult = NULL;    // result of the running replay, filled by the sinks below
+
+
+static void result_push(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime, double truth) {
+    Libreplay_Result_t *result = activeResult;
+    int64_t i = result->count;
+    if (i == result->capacity) {
+        result->capacity = result->capacity ? result->capacity * 2 : 4096;
+        result->local = realloc(result->local, result->capacity * sizeof(uint16_t));
+        result->neighbor = realloc(result->neighbor, result->capacity * sizeof(uint16_t));
+        result->distance = realloc(result->distance, result->capacity * sizeof(double));
+        result->timestamp = realloc(result->timestamp, result->capacity * sizeof(uint64_t));
+        result->systemTime = realloc(result->systemTime, result->capacity * sizeof(uint64_t));
+        result->truth = realloc(result->truth, result->capacity * sizeof(double));
+        result->warmup = realloc(result->warmup, result->capacity * sizeof(uint8_t));
+    }
+    result->local[i] = context->id;
+    result->neighbor[i] = neighborAddress;
+    result->distance[i] = distance;
+    result->timestamp[i] = timestamp;
+    result->systemTime[i] = systemTime;
+    result->truth[i] = truth;
+    result->warmup[i] = context->warmup;
+    result->count = i + 1;
+}
+
+static void collect_distance(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime) {
+    result_push(context, neighborAddress, distance, timestamp, systemTime, NAN);
+}
+
+static void collect_query(Drone_Context_t *context, const Trace_Query_t *query, double distance, uint64_t timestamp) {
+    result_push(context, query->neighbor, distance, timestamp, query->systemTime, query->truth);
+}
+
+static void collect_links(Libreplay_Result_t *result, const Replay_Swarm_t *swarm) {
+    int64_t count = 0;
+    for (int i = 0; i < swarm->count; i++) {
+        count += swarm->context[i].linkCount;
+    }
+    result->link = malloc((count > 0 ? count : 1) * sizeof(Libreplay_Link_t));
+    for (int i = 0; i < swarm->count; i++) {
+        const Drone_Context_t *context = &swarm->context[i];
+        for (int j = 0; j < context->linkCount; j++) {
+            const Link_Stats_t *link = &context->linkStats[j];
+            result->link[result->linkCount++] = (Libreplay_Link_t){
+                .local = context->id,
+                .neighbor = link->neighbor,
+                .received = link->received,
+                .lost = link->lost,
+                .zeroTimestamp = link->zeroTimestamp,
+                .distanceValid = link->distanceValid,
+                .distanceInvalid = link->distanceInvalid
+            };
+        }
+    }
+}
+
+int libreplay_version() {
+    return LIBREPLAY_VERSION;
+}
+
+/* the ranging mode the library was compiled for, as in the distance logs */
+const char *libreplay_mode() {
+    return RANGING_MODE;
+}
+
+/* loads the lines of [windowStart - warmup, windowEnd], windowStart 0 loads the whole trace */
+Libreplay_t *libreplay_open(const char *traceName, uint64_t windowStart, uint64_t windowEnd, uint64_t warmup) {
+    Libreplay_t *replay = calloc(1, sizeof(Libreplay_t));
+    uint64_t replay_start = windowStart > warmup ? windowStart - warmup : 0;
+    if (trace_load_window(&replay->trace, traceName, replay_start, windowEnd) <= 0) {
+        fprintf(stderr, "Failed to load %s\n", traceName);
+        trace_free(&replay->trace);
+        free(replay);
+        return NULL;
+    }
+    replay->windowStart = windowStart;
+    return replay;
+}
+
+/* vicon.txt or vicon.gt: later runs query the distance at its instants within [leftbound, rightbound] */
+int libreplay_query(Libreplay_t *replay, const char *queryName, uint64_t leftbound, uint64_t rightbound) {
+    if (replay->scheduled) {
+        schedule_free(&replay->schedule);
+        replay->scheduled = false;
+    }
+    if (replay->stored) {
+        gt_close(&replay->store);
+        replay->stored = false;
+    }
+    if (queryName == NULL) {
+        return 0;
+    }
+    if (gt_probe(queryName)) {
+        replay->stored = gt_open(&replay->store, queryName, leftbound, rightbound) >= 0;
+        return replay->stored ? 0 : -1;
+    }
+    replay->scheduled = schedule_load(&replay->schedule, queryName, leftbound, rightbound) >= 0;
+    return replay->scheduled ? 0 : -1;
+}
+
+/* replays the trace from fresh drone contexts, NULL if it fails */
+Libreplay_Result_t *libreplay_run(Libreplay_t *replay, const Libreplay_Options_t *options) {
+    if (activeResult != NULL) {
+        fprintf(stderr, "A replay is already running in this process\n");
+        return NULL;
+    }
+    Libreplay_Options_t defaults = {.packetLoss = -1};
+    if (options == NULL) {
+        options = &defaults;
+    }
+
+    // the node globals are set for this run only
+    double packet_loss = packetLoss;
+    int check_point = checkPoint;
+    packetLoss = options->packetLoss >= 0 ? options->packetLoss : PACKET_LOSS;
+    checkPoint = options->checkPoint > 0 ? options->checkPoint : CHECK_POINT;
+    nodeTrace = &replay->trace;
+    distanceSink = collect_distance;
+    querySchedule = replay->scheduled ? &replay->schedule : NULL;
+    groundTruth = replay->stored ? &replay->store : NULL;
+    querySink = collect_query;
+    Libreplay_Result_t *result = calloc(1, sizeof(Libreplay_Result_t));
+    activeResult = result;
+
+    Replay_Config_t config = {
+        .lineLimit = options->lineLimit,
+        .rangingPeriodRate = options->rangingPeriodRate > 0 ? options->rangingPeriodRate : RANGING_PERIOD_RATE,
+        .windowStart = replay->windowStart,
+        .workers = 1
+    };
+    Replay_Swarm_t swarm;
+    replay_swarm_init(&swarm, &replay->trace);
+    result->replayed = replay_run(&swarm, &replay->trace, &config);
+    collect_links(result, &swarm);
+    replay_swarm_free(&swarm);
+
+    activeResult = NULL;
+    nodeTrace = NULL;
+    distanceSink = log_distance;
+    querySchedule = NULL;
+    groundTruth = NULL;
+    querySink = log_query;
+    packetLoss = packet_loss;
+    checkPoint = check_point;
+    if (result->replayed < 0) {
+        libreplay_result_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+void libreplay_result_free(Libreplay_Result_t *result) {
+    if (result == NULL) {
+        return;
+    }
+    free(result->local);
+    free(result->neighbor);
+    free(result->distance);
+    free(result->timestamp);
+    free(result->systemTime);
+    free(result->truth);
+    free(result->warmup);
+    free(result->link);
+    free(result);
+}
+
+void libreplay_close(Libreplay_t *replay) {
+    if (replay == NULL) {
+        return;
+    }
+    libreplay_query(replay, NULL, 0, 0);
+    trace_free(&replay->trace);
+    free(replay);
+}
@@ -0,0 +1,60 @@
+#ifndef LIBREPLAY_H
+#define LIBREPLAY_H
+
+
+#include <stdint.h>
+
+
+#define     LIBREPLAY_VERSION       1       // bumped whenever a struct or signature below changes
+
+
+/*
+ * In-process replay of a trace, the core of sim behind a stable C API for bindings (script/libreplay.py).
+ * The ranging library keeps its state in globals, so one replay runs at a time per process; a handle keeps its trace
+ * and query schedule loaded between runs. Every run returns its own result, owned by the caller until
+ * libreplay_result_free, so bindings can hand its arrays out without copying them.
+ */
+typedef struct Libreplay Libreplay_t;
+
+typedef struct {
+    int lineLimit;                  // replay only the first lines, 0 replays all of them
+    int rangingPeriodRate;          // 0 keeps RANGING_PERIOD_RATE
+    double packetLoss;              // < 0 keeps PACKET_LOSS
+    int checkPoint;                 // 0 keeps CHECK_POINT, which samples nothing if it is 0 too
+} Libreplay_Options_t;
+
+typedef struct {
+    uint16_t local;
+    uint16_t neighbor;
+    uint32_t reserved;
+    uint64_t received;
+    uint64_t lost;
+    uint64_t zeroTimestamp;
+    uint64_t distanceValid;
+    uint64_t distanceInvalid;
+} Libreplay_Link_t;                 // counters of one local <- neighbor link at the end of a run
+
+typedef struct {
+    int64_t count;                  // entries of every column, one per distance in output order of sim
+    uint16_t *local;
+    uint16_t *neighbor;
+    double *distance;               // -1 when the ranging library could not compute one
+    uint64_t *timestamp;            // on the receiver's clock
+    uint64_t *systemTime;
+    double *truth;                  // ground truth of the query instant, NaN without a query schedule
+    uint8_t *warmup;                // 1 before the replay window
+    Libreplay_Link_t *link;
+    int64_t linkCount;
+    int64_t replayed;               // trace lines replayed
+    int64_t capacity;               // allocated entries of every column
+} Libreplay_Result_t;
+
+
+int libreplay_version();
+const char *libreplay_mode();
+Libreplay_t *libreplay_open(const char *traceName, uint64_t windowStart, uint64_t windowEnd, uint64_t warmup);
+int libreplay_query(Libreplay_t *replay, const char *queryName, uint64_t leftbound, uint64_t rightbound);
+Libreplay_Result_t *libreplay_run(Libreplay_t *replay, const Libreplay_Options_t *options);
+void libreplay_result_free(Libreplay_Result_t *result);
+void libreplay_close(Libreplay_t *replay);
+#endif
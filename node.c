@@ -0,0 +1,398 @@
+#include <math.h>
+#include "node.h"
+
+
+_Static_assert(sizeof(Link_Stats_t) == 64, "Link_Stats_t must fit one cache line");
+
+#if defined(CLASSIC_RANGING_MODE)
+extern Ranging_Table_Set_t rangingTableSet;
+#elif defined(MODIFIED_RANGING_MODE)
+extern Ranging_Table_Set_t *rangingTableSet;
+#endif
+extern uint16_t TxCount;
+extern uint16_t RxCount;
+extern dwTime_t lastTxTimestamp;
+extern dwTime_t lastRxTimestamp;
+extern dwTime_t TxTimestamp;                            // store timestamp from flightLog
+extern dwTime_t RxTimestamp;                            // store timestamp from flightLog
+
+const char *localAddress;                               // address of the drone whose context is active
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;      // mutex for synchronizing access to the rangingTableSet
+double packetLoss = PACKET_LOSS;
+int checkPoint = CHECK_POINT;
+Trace_t *nodeTrace = NULL;
+Distance_Sink_t distanceSink = log_distance;
+Trace_Schedule_t *querySchedule = NULL;
+Gt_Store_t *groundTruth = NULL;
+Query_Sink_t querySink = log_query;
+
+static Drone_Context_t *activeContext = NULL;
+
+static struct {
+    FILE *fp;
+    Drone_Context_t *contexts;
+    int count;
+    uint64_t period;                                    // ns between snapshots, 0 snapshots only on request
+    uint64_t next;
+    int snapshot;
+} linkStats;
+
+
+void context_init(Drone_Context_t *context, const char *address) {
+    memset(context, 0, sizeof(Drone_Context_t));
+    snprintf(context->address, sizeof(context->address), "%s", address);
+    context->id = (uint16_t)strtoul(address, NULL, 10);
+    context->seed = 1;
+
+    context_switch(context);
+    #if defined(CLASSIC_RANGING_MODE)
+        rangingTableSetInit(&rangingTableSet);
+    #elif defined(MODIFIED_RANGING_MODE)
+        rangingTableSetInit();
+    #endif
+}
+
+void context_free(Drone_Context_t *context) {
+    // the next context_switch must not save the globals into a context that is gone
+    if (activeContext == context) {
+        activeContext = NULL;
+    }
+    free(context->linkStats);
+    free(context->linkSlot);
+    context->linkStats = NULL;
+    context->linkSlot = NULL;
+    context->linkCount = 0;
+    context->linkCapacity = 0;
+}
+
+void context_switch(Drone_Context_t *context) {
+    if (activeContext == context) {
+        return;
+    }
+
+    // save the globals of the drone that ran last
+    if (activeContext != NULL) {
+        activeContext->rangingTableSet = rangingTableSet;
+        activeContext->TxCount = TxCount;
+        activeContext->RxCount = RxCount;
+        activeContext->lastTxTimestamp = lastTxTimestamp;
+        activeContext->lastRxTimestamp = lastRxTimestamp;
+        activeContext->TxTimestamp = TxTimestamp;
+        activeContext->RxTimestamp = RxTimestamp;
+    }
+
+    rangingTableSet = context->rangingTableSet;
+    TxCount = context->TxCount;
+    RxCount = context->RxCount;
+    lastTxTimestamp = context->lastTxTimestamp;
+    lastRxTimestamp = context->lastRxTimestamp;
+    TxTimestamp = context->TxTimestamp;
+    RxTimestamp = context->RxTimestamp;
+    localAddress = context->address;
+    activeContext = context;
+}
+
+static void link_slot_insert(Drone_Context_t *context, int position) {
+    uint32_t mask = context->linkCapacity * 2 - 1;
+    uint32_t slot = context->linkStats[position].neighbor & mask;
+    while (context->linkSlot[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    context->linkSlot[slot] = position + 1;
+}
+
+/* counters of local <- neighbor, created on the first message from the neighbor */
+static Link_Stats_t *link_stats(Drone_Context_t *context, uint16_t neighborAddress) {
+    // open addressing with linear probing keeps the lookup flat as the number of neighbors grows
+    if (context->linkCapacity > 0) {
+        uint32_t mask = context->linkCapacity * 2 - 1;
+        for (uint32_t slot = neighborAddress & mask; context->linkSlot[slot] != 0; slot = (slot + 1) & mask) {
+            Link_Stats_t *link = &context->linkStats[context->linkSlot[slot] - 1];
+            if (link->neighbor == neighborAddress) {
+                return link;
+            }
+        }
+    }
+
+    if (context->linkCount == context->linkCapacity) {
+        int capacity = context->linkCapacity ? context->linkCapacity * 2 : 8;
+        Link_Stats_t *grown = aligned_alloc(64, capacity * sizeof(Link_Stats_t));
+        if (context->linkCount > 0) {
+            memcpy(grown, context->linkStats, context->linkCount * sizeof(Link_Stats_t));
+        }
+        free(context->linkStats);
+        free(context->linkSlot);
+        context->linkStats = grown;
+        context->linkCapacity = capacity;
+        context->linkSlot = calloc(capacity * 2, sizeof(int32_t));
+        for (int i = 0; i < context->linkCount; i++) {
+            link_slot_insert(context, i);
+        }
+    }
+
+    Link_Stats_t *link = &context->linkStats[context->linkCount];
+    memset(link, 0, sizeof(Link_Stats_t));
+    link->neighbor = neighborAddress;
+    link_slot_insert(context, context->linkCount++);
+    return link;
+}
+
+static void count_distance(Drone_Context_t *context, uint16_t neighborAddress, double distance) {
+    Link_Stats_t *link = link_stats(context, neighborAddress);
+    if (distance == INVALID_DISTANCE) {
+        link->distanceInvalid++;
+    }
+    else {
+        link->distanceValid++;
+    }
+}
+
+void log_distance(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime) {
+    #if defined(CLASSIC_RANGING_MODE)
+        DEBUG_PRINT("%s[local_%u <- neighbor_%u]: %s dist = %d, time = %llu\n", context->warmup ? "[warmup] " : "", context->id, neighborAddress, RANGING_MODE, (int16_t)distance, timestamp);
+    #elif defined(MODIFIED_RANGING_MODE)
+        DEBUG_PRINT("%s[local_%u <- neighbor_%u]: %s dist = %f, time = %llu\n", context->warmup ? "[warmup] " : "", context->id, neighborAddress, RANGING_MODE, distance, timestamp);
+    #endif
+}
+
+void log_query(Drone_Context_t *context, const Trace_Query_t *query, double distance, uint64_t timestamp) {
+    DEBUG_PRINT("%s[local_%u <- neighbor_%u]: %s dist = %f, time = %llu, sys_time = %llu, vicon = %f\n", context->warmup ? "[warmup] " : "", context->id, query->neighbor, RANGING_MODE, distance, timestamp, query->systemTime, query->truth);
+}
+
+/* evaluate the distance at one ground-truth instant, mapped onto the receiver's timestamp domain */
+static void query_instant(Drone_Context_t *context, uint16_t neighborAddress, const Trace_Query_t *query, uint64_t timestamp, uint64_t systemTime, double ticks_per_system) {
+    uint64_t query_timestamp = (timestamp + (uint64_t)((query->systemTime - systemTime) * ticks_per_system)) % UWB_MAX_TIMESTAMP;
+    #if defined(CLASSIC_RANGING_MODE)
+        double distance = getDistance(neighborAddress);
+    #elif defined(MODIFIED_RANGING_MODE)
+        double distance = getCurDistance(neighborAddress, query_timestamp);
+    #endif
+    count_distance(context, neighborAddress, distance);
+    querySink(context, query, distance, query_timestamp);
+    telemetry_publish(context->id, neighborAddress, distance, query->truth, query_timestamp, query->systemTime);
+}
+
+/* query the distance only at the ground-truth instants between this reception and the next one */
+static void query_distance(Drone_Context_t *context, uint16_t neighborAddress, uint64_t timestamp, uint64_t systemTime, uint64_t nextTimestamp, uint64_t nextSystemTime) {
+    if (nextSystemTime <= systemTime) {
+        return;
+    }
+    uint64_t rx_interval = (nextTimestamp - timestamp + UWB_MAX_TIMESTAMP) % UWB_MAX_TIMESTAMP;
+    double ticks_per_system = (double)rx_interval / (double)(nextSystemTime - systemTime);
+
+    if (querySchedule != NULL) {
+        for (int i = schedule_lower_bound(querySchedule, context->id, neighborAddress, systemTime); i < querySchedule->queryCount; i++) {
+            const Trace_Query_t *query = &querySchedule->query[i];
+            if (query->local != context->id || query->neighbor != neighborAddress || query->systemTime >= nextSystemTime) {
+                break;
+            }
+            query_instant(context, neighborAddress, query, timestamp, systemTime, ticks_per_system);
+        }
+        return;
+    }
+
+    // every frame of the ground-truth store is an instant, its truth is computed for this link only
+    for (int i = gt_lower_bound(groundTruth, systemTime); i < groundTruth->frameEnd; i++) {
+        Trace_Query_t query = {
+            .local = context->id,
+            .neighbor = neighborAddress,
+            .systemTime = gt_frame_time(groundTruth, i)
+        };
+        if (query.systemTime >= nextSystemTime || !gt_distance(groundTruth, query.local, query.neighbor, query.systemTime, &query.truth)) {
+            break;
+        }
+        query_instant(context, neighborAddress, &query, timestamp, systemTime, ticks_per_system);
+    }
+}
+
+/* query the distance to the sender at CHECK_POINT instants evenly spaced until the next reception */
+static void sample_distance(Drone_Context_t *context, uint16_t neighborAddress, dwTime_t timestamp) {
+    int current = trace_find_rx(nodeTrace, context->tracePos, context->id, timestamp.full);
+    uint64_t next_RxTimestamp = NULL_TIMESTAMP;
+    int next = current < 0 ? -1 : trace_next_rx(nodeTrace, current, context->id, &next_RxTimestamp);
+    uint64_t systemTime = current < 0 ? 0 : nodeTrace->line[current].systemTime;
+
+    if (next >= 0) {
+        context->tracePos = next;
+    }
+    else if (current >= 0) {
+        context->tracePos = current + 1;
+    }
+
+    if (querySchedule != NULL || groundTruth != NULL) {
+        if (next >= 0) {
+            query_distance(context, neighborAddress, timestamp.full, systemTime, next_RxTimestamp, nodeTrace->line[next].systemTime);
+        }
+        return;
+    }
+
+    uint64_t check_interval = 0;
+    uint64_t system_interval = 0;
+    if (next >= 0) {
+        check_interval = ((next_RxTimestamp - timestamp.full + UWB_MAX_TIMESTAMP) % UWB_MAX_TIMESTAMP) / (checkPoint + 1);
+        system_interval = (nodeTrace->line[next].systemTime - systemTime) / (checkPoint + 1);
+    }
+
+    for (int i = 1; i <= checkPoint; i++) {
+        uint64_t check_timestamp = (timestamp.full + check_interval * i) % UWB_MAX_TIMESTAMP;
+        #if defined(CLASSIC_RANGING_MODE)
+            double distance = getDistance(neighborAddress);
+        #elif defined(MODIFIED_RANGING_MODE)
+            double distance = getCurDistance(neighborAddress, next >= 0 ? check_timestamp : NULL_TIMESTAMP);
+        #endif
+        count_distance(context, neighborAddress, distance);
+        distanceSink(context, neighborAddress, distance, check_timestamp, systemTime + system_interval * i);
+        telemetry_publish(context->id, neighborAddress, distance, NAN, check_timestamp, systemTime + system_interval * i);
+    }
+}
+
+void node_tx(Drone_Context_t *context, dwTime_t timestamp, Ranging_Message_t *rangingMessage) {
+    context_switch(context);
+    context->txMessages++;
+
+    #if defined(CLASSIC_RANGING_MODE)
+        generateRangingMessage(rangingMessage);
+        Timestamp_Tuple_t curTimeTuple = {
+            .timestamp = timestamp,
+            .seqNumber = rangingMessage->header.msgSequence
+        };
+        updateTfBuffer(curTimeTuple);
+
+        // reset of TxTimestamp in other place
+    #elif defined(MODIFIED_RANGING_MODE)
+        generateDSRMessage(rangingMessage);
+        Timestamp_Tuple_t curTimeTuple = {
+            .timestamp = timestamp,
+            .seqNumber = rangingMessage->header.msgSequence
+        };
+        updateSendList(&rangingTableSet->sendList, curTimeTuple);
+
+        // reset TxTimestamp after callback
+        TxTimestamp.full = 0;
+    #endif
+}
+
+void node_rx(Drone_Context_t *context, Ranging_Message_t *rangingMessage, dwTime_t timestamp) {
+    context_switch(context);
+
+    Link_Stats_t *link = link_stats(context, rangingMessage->header.srcAddress);
+    link->received++;
+    uint16_t length = rangingMessage->header.msgLength < UWB_FRAME_LEN_MAX ? rangingMessage->header.msgLength : UWB_FRAME_LEN_MAX;
+    link->sizeHist[length * LINK_SIZE_BUCKETS / (UWB_FRAME_LEN_MAX + 1)]++;
+    if (linkStats.period != 0 && get_monotonic_time() >= linkStats.next) {
+        link_stats_snapshot();
+    }
+
+    int randnum = rand_r(&context->seed) % 10000;
+    if (randnum < (int)(packetLoss * 10000)) {
+        link->lost++;
+        return;
+    }
+    if (timestamp.full == 0) {
+        link->zeroTimestamp++;
+        return;
+    }
+
+    #if defined(CLASSIC_RANGING_MODE)
+        Ranging_Message_With_Timestamp_t rangingMessageWithTimestamp;
+        rangingMessageWithTimestamp.rangingMessage = *rangingMessage;
+        rangingMessageWithTimestamp.rxTime = timestamp;
+        
+        processRangingMessage(&rangingMessageWithTimestamp);
+
+        if (nodeTrace != NULL) {
+            sample_distance(context, rangingMessage->header.srcAddress, timestamp);
+        }
+
+        // reset of RxTimestamp in other place
+    #elif defined(MODIFIED_RANGING_MODE)
+        Ranging_Message_With_Additional_Info_t rangingMessageWithAdditionalInfo;
+        rangingMessageWithAdditionalInfo.rangingMessage = *rangingMessage;
+        rangingMessageWithAdditionalInfo.timestamp = timestamp;
+
+        processDSRMessage(&rangingMessageWithAdditionalInfo);
+
+        if (nodeTrace != NULL) {
+            sample_distance(context, rangingMessage->header.srcAddress, timestamp);
+        }
+
+        // reset RxTimestamp after callback
+        RxTimestamp.full = 0;
+    #endif
+}
+
+/* periodic CSV snapshots of the link counters of every hosted drone */
+int link_stats_open(const char *filename, Drone_Context_t *contexts, int count, uint64_t period) {
+    linkStats.fp = fopen(filename, "w");
+    if (linkStats.fp == NULL) {
+        perror("Failed to open link stats file");
+        return -1;
+    }
+    fprintf(linkStats.fp, "snapshot,time_ms,local,neighbor,received,lost,zero_timestamp,distance_valid,distance_invalid,tx_messages,tx_wraparounds,rx_wraparounds");
+    for (int i = 0; i < LINK_SIZE_BUCKETS; i++) {
+        fprintf(linkStats.fp, ",size_%d", i * (UWB_FRAME_LEN_MAX + 1) / LINK_SIZE_BUCKETS);
+    }
+    fprintf(linkStats.fp, "\n");
+
+    linkStats.contexts = contexts;
+    linkStats.count = count;
+    linkStats.period = period;
+    linkStats.next = get_monotonic_time() + period;
+    linkStats.snapshot = 0;
+    return 0;
+}
+
+void link_stats_snapshot() {
+    if (linkStats.fp == NULL) {
+        return;
+    }
+
+    // the wraparound counters of the active drone still live in the library globals
+    Drone_Context_t *active = activeContext;
+    if (active != NULL) {
+        active->TxCount = TxCount;
+        active->RxCount = RxCount;
+    }
+
+    uint64_t now = get_monotonic_time();
+    for (int i = 0; i < linkStats.count; i++) {
+        Drone_Context_t *context = &linkStats.contexts[i];
+        for (int j = 0; j < context->linkCount; j++) {
+            Link_Stats_t *link = &context->linkStats[j];
+            fprintf(linkStats.fp, "%d,%lu,%u,%u,%u,%u,%u,%u,%u,%lu,%u,%u", linkStats.snapshot, now / 1000000, context->id, link->neighbor,
+                    link->received, link->lost, link->zeroTimestamp, link->distanceValid, link->distanceInvalid,
+                    context->txMessages, context->TxCount, context->RxCount);
+            for (int k = 0; k < LINK_SIZE_BUCKETS; k++) {
+                fprintf(linkStats.fp, ",%u", link->sizeHist[k]);
+            }
+            fprintf(linkStats.fp, "\n");
+        }
+    }
+    fflush(linkStats.fp);
+    linkStats.snapshot++;
+    linkStats.next = now + linkStats.period;
+}
+
+void link_stats_close() {
+    if (linkStats.fp != NULL) {
+        link_stats_snapshot();
+        fclose(linkStats.fp);
+        linkStats.fp = NULL;
+    }
+}
+
+/* the sharded replay takes the file over, each shard writes the final snapshot of its contexts to a file of its own */
+FILE *link_stats_detach() {
+    FILE *fp = linkStats.fp;
+    memset(&linkStats, 0, sizeof(linkStats));
+    return fp;
+}
+
+void link_stats_attach(FILE *fp, Drone_Context_t *contexts, int count) {
+    linkStats.fp = fp;
+    linkStats.contexts = contexts;
+    linkStats.count = count;
+    linkStats.period = 0;
+    linkStats.next = 0;
+    linkStats.snapshot = 0;
+}
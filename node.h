@@ -0,0 +1,79 @@
+#ifndef NODE_H
+#define NODE_H
+
+
+#include "frame.h"
+#include "gt.h"
+#include "telemetry.h"
+#include "trace.h"
+
+
+#define     INVALID_DISTANCE        -1      // distance reported by the ranging library when it cannot compute one
+#define     LINK_SIZE_BUCKETS       8       // msgLength histogram, UWB_FRAME_LEN_MAX / LINK_SIZE_BUCKETS bytes per bucket
+
+
+/* counters of one local <- neighbor link, 56 bytes padded to one cache line; 32 bits last a link 49 days at 1 kHz */
+typedef struct {
+    uint16_t neighbor;
+    uint32_t received;                  // messages handed to RxCallBack
+    uint32_t lost;                      // dropped by PACKET_LOSS
+    uint32_t zeroTimestamp;             // dropped for a zero Rx timestamp
+    uint32_t distanceValid;             // sampled distances the library could compute
+    uint32_t distanceInvalid;
+    uint32_t sizeHist[LINK_SIZE_BUCKETS];
+} __attribute__((aligned(64))) Link_Stats_t;
+
+/* ranging state of one simulated drone, swapped into the ranging library's globals before each callback */
+typedef struct {
+    char address[ADDR_SIZE];
+    uint16_t id;
+    #if defined(CLASSIC_RANGING_MODE)
+    Ranging_Table_Set_t rangingTableSet;
+    #elif defined(MODIFIED_RANGING_MODE)
+    Ranging_Table_Set_t *rangingTableSet;
+    #endif
+    uint16_t TxCount;
+    uint16_t RxCount;
+    dwTime_t lastTxTimestamp;
+    dwTime_t lastRxTimestamp;
+    dwTime_t TxTimestamp;
+    dwTime_t RxTimestamp;
+    unsigned int seed;                  // per-drone PACKET_LOSS stream
+    int tracePos;                       // search position in nodeTrace for CHECK_POINT sampling
+    uint64_t deadline;                  // deadline of the next trace event in paced replay, 0 when unpaced
+    bool warmup;                        // the current line precedes the replay window, outputs are marked [warmup]
+    uint64_t txMessages;
+    Link_Stats_t *linkStats;            // per neighbor, in order of first reception
+    int32_t *linkSlot;                  // open-addressed neighbor -> linkStats position + 1, 2 * linkCapacity slots
+    int linkCount;
+    int linkCapacity;
+} Drone_Context_t;
+
+/* receives every distance sampled at a CHECK_POINT, systemTime is interpolated from the trace */
+typedef void (*Distance_Sink_t)(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime);
+/* receives the distance evaluated at a scheduled query instant, timestamp is the instant mapped onto the receiver's clock */
+typedef void (*Query_Sink_t)(Drone_Context_t *context, const Trace_Query_t *query, double distance, uint64_t timestamp);
+
+
+extern double packetLoss;               // PACKET_LOSS unless overridden at runtime
+extern int checkPoint;                  // CHECK_POINT unless overridden at runtime
+extern Trace_t *nodeTrace;              // trace used for CHECK_POINT sampling, NULL disables sampling
+extern Distance_Sink_t distanceSink;
+extern Trace_Schedule_t *querySchedule;  // replaces CHECK_POINT sampling with ground-truth instants, NULL disables it
+extern Gt_Store_t *groundTruth;         // without querySchedule, its frames are the instants, NULL disables it
+extern Query_Sink_t querySink;
+
+
+void context_init(Drone_Context_t *context, const char *address);
+void context_switch(Drone_Context_t *context);
+void context_free(Drone_Context_t *context);
+void node_tx(Drone_Context_t *context, dwTime_t timestamp, Ranging_Message_t *rangingMessage);
+void node_rx(Drone_Context_t *context, Ranging_Message_t *rangingMessage, dwTime_t timestamp);
+void log_distance(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime);
+void log_query(Drone_Context_t *context, const Trace_Query_t *query, double distance, uint64_t timestamp);
+int link_stats_open(const char *filename, Drone_Context_t *contexts, int count, uint64_t period);
+void link_stats_snapshot();
+void link_stats_close();
+FILE *link_stats_detach();
+void link_stats_attach(FILE *fp, Drone_Context_t *contexts, int count);
+#endif
@@ -0,0 +1,464 @@
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "replay.h"
+
+
+#define     SHARD_SPIN              1024    // polls of a shard wait before it starts yielding the core
+
+
+extern dwTime_t TxTimestamp;
+extern dwTime_t RxTimestamp;
+
+
+typedef struct {
+    _Atomic int64_t line;               // trace line whose Tx message the slot holds, -1 before the first
+    Ranging_Message_t message;
+} Shard_Slot_t;
+
+typedef struct {
+    _Atomic int64_t done;               // lines the shard has finished
+} __attribute__((aligned(64))) Shard_Progress_t;
+
+/* shared between the shards of a replay, mapped before they are forked */
+typedef struct {
+    _Atomic int *failed;                // set when a shard dies, the others stop waiting
+    Shard_Progress_t *progress;         // one per shard
+    Shard_Slot_t *slot;                 // the Tx message of line i is in slot i % REPLAY_SHARD_RING
+    size_t size;
+} Shard_Ring_t;
+
+/* output of one node_rx call in a shard file, shard files are merged by (line, rank) */
+typedef struct {
+    uint32_t line;
+    uint32_t rank;
+    uint64_t length;
+} Shard_Span_t;
+
+
+static void swarm_add(Replay_Swarm_t *swarm, uint16_t address) {
+    if (address == 0 || swarm->index[address] >= 0) {
+        return;
+    }
+    swarm->index[address] = (int16_t)swarm->count++;
+}
+
+/* one drone context per address that transmits or receives in the trace */
+int replay_swarm_init(Replay_Swarm_t *swarm, const Trace_t *trace) {
+    swarm->count = 0;
+    swarm->index = malloc(ADDRESS_INDEX_SIZE * sizeof(int16_t));
+    memset(swarm->index, -1, ADDRESS_INDEX_SIZE * sizeof(int16_t));
+
+    for (int i = 0; i < trace->lineCount; i++) {
+        swarm_add(swarm, trace->line[i].srcAddress);
+    }
+    for (int i = 0; i < trace->rxTotal; i++) {
+        swarm_add(swarm, trace->rx[i].address);
+    }
+
+    // order contexts by address so that replays do not depend on the trace layout
+    swarm->context = malloc(swarm->count * sizeof(Drone_Context_t));
+    int position = 0;
+    for (int address = 0; address < ADDRESS_INDEX_SIZE; address++) {
+        if (swarm->index[address] >= 0) {
+            char name[ADDR_SIZE];
+            snprintf(name, sizeof(name), "%d", address);
+            swarm->index[address] = (int16_t)position;
+            context_init(&swarm->context[position++], name);
+        }
+    }
+    return swarm->count;
+}
+
+void replay_swarm_free(Replay_Swarm_t *swarm) {
+    for (int i = 0; i < swarm->count; i++) {
+        context_free(&swarm->context[i]);
+    }
+    free(swarm->context);
+    free(swarm->index);
+    memset(swarm, 0, sizeof(Replay_Swarm_t));
+}
+
+static int replay_line_total(const Trace_t *trace, const Replay_Config_t *config) {
+    return config->lineLimit > 0 && config->lineLimit < trace->lineCount ? config->lineLimit : trace->lineCount;
+}
+
+/* context of the sender of line i, -1 if RANGING_PERIOD_RATE skips the line or the sender is unknown */
+static int replay_source(const Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config, int i) {
+    int rate = config->rangingPeriodRate > 0 ? config->rangingPeriodRate : 1;
+    if (((trace->firstLine + i) / swarm->count) % rate != 0) {
+        return -1;
+    }
+    return swarm->index[trace->line[i].srcAddress];
+}
+
+static int replay_run_sharded(Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config);
+
+/* the lockstep of center and drones without sockets: Tx, Rx task allocation, then broadcast */
+int replay_run(Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config) {
+    if (config->workers > 1 && swarm->count > 1) {
+        return replay_run_sharded(swarm, trace, config);
+    }
+
+    int line_total = replay_line_total(trace, config);
+    int replayed = 0;
+
+    for (int i = 0; i < line_total; i++) {
+        int src = replay_source(swarm, trace, config, i);
+        if (src < 0) {
+            continue;
+        }
+
+        // Tx task allocation
+        const Trace_Line_t *line = &trace->line[i];
+        bool warmup = line->systemTime < config->windowStart;
+        Ranging_Message_t ranging_msg;
+        context_switch(&swarm->context[src]);
+        swarm->context[src].warmup = warmup;
+        TxTimestamp.full = line->txTimestamp.full;
+        node_tx(&swarm->context[src], TxTimestamp, &ranging_msg);
+
+        // a sparse trace lists who heard the message, nobody else gets a copy
+        const Trace_Rx_t *rx = &trace->rx[line->rxIndex];
+        if (trace->sparse) {
+            for (int j = 0; j < line->rxCount; j++) {
+                int receiver = swarm->index[rx[j].address];
+                if (receiver < 0 || receiver == src) {
+                    continue;
+                }
+                context_switch(&swarm->context[receiver]);
+                RxTimestamp.full = rx[j].timestamp.full;
+                swarm->context[receiver].warmup = warmup;
+                node_rx(&swarm->context[receiver], &ranging_msg, RxTimestamp);
+            }
+            replayed++;
+            continue;
+        }
+
+        // Rx task allocation
+        for (int j = 0; j < line->rxCount; j++) {
+            int receiver = swarm->index[rx[j].address];
+            if (receiver >= 0) {
+                context_switch(&swarm->context[receiver]);
+                RxTimestamp.full = rx[j].timestamp.full;
+            }
+        }
+
+        // broadcast
+        for (int j = 0; j < swarm->count; j++) {
+            if (j == src) {
+                continue;
+            }
+            context_switch(&swarm->context[j]);
+            swarm->context[j].warmup = warmup;
+            node_rx(&swarm->context[j], &ranging_msg, RxTimestamp);
+        }
+        replayed++;
+    }
+    return replayed;
+}
+
+
+/* spin, then yield: a shard normally has a core of its own and waits only for a neighbor's Tx */
+static int shard_wait_slot(const Shard_Ring_t *ring, const Shard_Slot_t *slot, int64_t line) {
+    for (int spin = 0; atomic_load_explicit(&slot->line, memory_order_acquire) != line; spin++) {
+        if (atomic_load_explicit(ring->failed, memory_order_relaxed)) {
+            return -1;
+        }
+        if (spin >= SHARD_SPIN) {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+/* until every shard has finished the lines before line, so the slot they read may be reused */
+static int shard_wait_progress(const Shard_Ring_t *ring, int workers, int64_t line) {
+    for (int w = 0; w < workers; w++) {
+        for (int spin = 0; atomic_load_explicit(&ring->progress[w].done, memory_order_acquire) < line; spin++) {
+            if (atomic_load_explicit(ring->failed, memory_order_relaxed)) {
+                return -1;
+            }
+            if (spin >= SHARD_SPIN) {
+                sched_yield();
+            }
+        }
+    }
+    return 0;
+}
+
+/* the output written since the last span belongs to (line, rank) */
+static void shard_span(FILE *data, FILE *index, long *position, int line, int rank) {
+    long end = ftell(data);
+    if (end != *position) {
+        Shard_Span_t span = {
+            .line = (uint32_t)line,
+            .rank = (uint32_t)rank,
+            .length = (uint64_t)(end - *position)
+        };
+        fwrite(&span, sizeof(span), 1, index);
+        *position = end;
+    }
+}
+
+/*
+ * One shard replays every line for the contexts [first, last): the Tx of its own senders goes into the ring,
+ * receptions wait for the Tx of their line. A shard runs ahead of the others until the ring is full, no shard
+ * waits for a line it does not take part in. Rank orders the receptions of a line as the sequential replay does.
+ */
+static int shard_worker(Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config, const Shard_Ring_t *ring, int shard, int workers, FILE *data, FILE *index) {
+    int first = shard * swarm->count / workers;
+    int last = (shard + 1) * swarm->count / workers;
+    int line_total = replay_line_total(trace, config);
+    long position = 0;
+    *config->output = data;
+    fseek(data, 0, SEEK_SET);           // a known offset lets ftell answer without a syscall
+
+    for (int i = 0; i < line_total; i++) {
+        int src = replay_source(swarm, trace, config, i);
+        if (src < 0) {
+            atomic_store_explicit(&ring->progress[shard].done, i + 1, memory_order_release);
+            continue;
+        }
+
+        const Trace_Line_t *line = &trace->line[i];
+        bool warmup = line->systemTime < config->windowStart;
+        Shard_Slot_t *slot = &ring->slot[i & (REPLAY_SHARD_RING - 1)];
+        if (src >= first && src < last) {
+            if (shard_wait_progress(ring, workers, (int64_t)i - REPLAY_SHARD_RING + 1) < 0) {
+                return -1;
+            }
+            context_switch(&swarm->context[src]);
+            swarm->context[src].warmup = warmup;
+            TxTimestamp.full = line->txTimestamp.full;
+            node_tx(&swarm->context[src], TxTimestamp, &slot->message);
+            atomic_store_explicit(&slot->line, i, memory_order_release);
+        }
+
+        Ranging_Message_t ranging_msg;
+        bool received = false;
+        const Trace_Rx_t *rx = &trace->rx[line->rxIndex];
+        if (trace->sparse) {
+            for (int j = 0; j < line->rxCount; j++) {
+                int receiver = swarm->index[rx[j].address];
+                if (receiver < first || receiver >= last || receiver == src) {
+                    continue;
+                }
+                if (!received) {
+                    if (shard_wait_slot(ring, slot, i) < 0) {
+                        return -1;
+                    }
+                    ranging_msg = slot->message;
+                    received = true;
+                }
+                context_switch(&swarm->context[receiver]);
+                RxTimestamp.full = rx[j].timestamp.full;
+                swarm->context[receiver].warmup = warmup;
+                node_rx(&swarm->context[receiver], &ranging_msg, RxTimestamp);
+                shard_span(data, index, &position, i, j);
+            }
+        }
+        else {
+            for (int j = 0; j < line->rxCount; j++) {
+                int receiver = swarm->index[rx[j].address];
+                if (receiver >= first && receiver < last) {
+                    context_switch(&swarm->context[receiver]);
+                    RxTimestamp.full = rx[j].timestamp.full;
+                }
+            }
+            for (int j = first; j < last; j++) {
+                if (j == src) {
+                    continue;
+                }
+                if (!received) {
+                    if (shard_wait_slot(ring, slot, i) < 0) {
+                        return -1;
+                    }
+                    ranging_msg = slot->message;
+                    received = true;
+                }
+                context_switch(&swarm->context[j]);
+                swarm->context[j].warmup = warmup;
+                node_rx(&swarm->context[j], &ranging_msg, RxTimestamp);
+                shard_span(data, index, &position, i, j);
+            }
+        }
+        atomic_store_explicit(&ring->progress[shard].done, i + 1, memory_order_release);
+    }
+
+    link_stats_close();
+    if (fflush(data) != 0 || fflush(index) != 0) {
+        perror("Failed to write shard output");
+        return -1;
+    }
+    return 0;
+}
+
+static int shard_ring_open(Shard_Ring_t *ring, int workers) {
+    size_t progress_offset = 64;
+    size_t slot_offset = progress_offset + workers * sizeof(Shard_Progress_t);
+    ring->size = slot_offset + REPLAY_SHARD_RING * sizeof(Shard_Slot_t);
+    uint8_t *base = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("Failed to map shard ring");
+        return -1;
+    }
+    ring->failed = (_Atomic int *)base;
+    ring->progress = (Shard_Progress_t *)(base + progress_offset);
+    ring->slot = (Shard_Slot_t *)(base + slot_offset);
+    for (int i = 0; i < REPLAY_SHARD_RING; i++) {
+        atomic_init(&ring->slot[i].line, -1);
+    }
+    return 0;
+}
+
+static int shard_copy(FILE *from, FILE *to, uint64_t length) {
+    char buffer[65536];
+    while (length > 0) {
+        size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+        if (fread(buffer, 1, chunk, from) != chunk) {
+            return -1;
+        }
+        fwrite(buffer, 1, chunk, to);
+        length -= chunk;
+    }
+    return 0;
+}
+
+/* every shard file is ordered by (line, rank) already, so a k-way merge restores the sequential order */
+static int shard_merge(FILE **data, FILE **index, int workers, FILE *output) {
+    Shard_Span_t *head = malloc(workers * sizeof(Shard_Span_t));
+    bool *open = malloc(workers * sizeof(bool));
+    for (int w = 0; w < workers; w++) {
+        rewind(data[w]);
+        rewind(index[w]);
+        open[w] = fread(&head[w], sizeof(Shard_Span_t), 1, index[w]) == 1;
+    }
+
+    int result = 0;
+    while (result == 0) {
+        int next = -1;
+        for (int w = 0; w < workers; w++) {
+            if (open[w] && (next < 0 || head[w].line < head[next].line || (head[w].line == head[next].line && head[w].rank < head[next].rank))) {
+                next = w;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        result = shard_copy(data[next], output, head[next].length);
+        open[next] = fread(&head[next], sizeof(Shard_Span_t), 1, index[next]) == 1;
+    }
+    free(head);
+    free(open);
+    return result;
+}
+
+/*
+ * The ranging library keeps the state of the active drone in process globals, so shards are processes rather than
+ * threads: each owns a contiguous range of contexts, Tx messages are exchanged through a shared ring and the outputs
+ * are merged afterwards, byte for byte what replay_run writes sequentially.
+ */
+static int replay_run_sharded(Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config) {
+    int workers = config->workers < swarm->count ? config->workers : swarm->count;
+    Shard_Ring_t ring;
+    if (shard_ring_open(&ring, workers) < 0) {
+        return -1;
+    }
+
+    // the link counters of each shard are appended in shard order, which is context order
+    FILE *link_stats = link_stats_detach();
+    FILE **data = calloc(workers, sizeof(FILE *));
+    FILE **index = calloc(workers, sizeof(FILE *));
+    FILE **stats = calloc(workers, sizeof(FILE *));
+    int result = 0;
+    for (int w = 0; w < workers && result == 0; w++) {
+        data[w] = tmpfile();
+        index[w] = tmpfile();
+        stats[w] = link_stats != NULL ? tmpfile() : NULL;
+        if (data[w] == NULL || index[w] == NULL || (link_stats != NULL && stats[w] == NULL)) {
+            perror("Failed to create shard file");
+            result = -1;
+        }
+    }
+
+    // buffered output must not be written twice by the children
+    fflush(NULL);
+    int started = 0;
+    for (; started < workers && result == 0; started++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Failed to fork shard");
+            atomic_store(ring.failed, 1);
+            result = -1;
+            break;
+        }
+        if (pid == 0) {
+            if (link_stats != NULL) {
+                int first = started * swarm->count / workers;
+                int last = (started + 1) * swarm->count / workers;
+                link_stats_attach(stats[started], &swarm->context[first], last - first);
+            }
+            _exit(shard_worker(swarm, trace, config, &ring, started, workers, data[started], index[started]) < 0 ? 1 : 0);
+        }
+    }
+
+    // a shard that dies releases the others, which would wait for its Tx forever
+    for (int remaining = started; remaining > 0; remaining--) {
+        int status;
+        if (wait(&status) < 0) {
+            perror("Failed to wait for shard");
+            result = -1;
+            break;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            atomic_store(ring.failed, 1);
+            result = -1;
+        }
+    }
+    if (result < 0) {
+        fprintf(stderr, "Sharded replay failed\n");
+    }
+
+    if (result == 0 && shard_merge(data, index, workers, *config->output) < 0) {
+        fprintf(stderr, "Failed to merge shard output\n");
+        result = -1;
+    }
+    for (int w = 0; w < workers; w++) {
+        if (result == 0 && stats[w] != NULL) {
+            char buffer[65536];
+            size_t length;
+            rewind(stats[w]);
+            while ((length = fread(buffer, 1, sizeof(buffer), stats[w])) > 0) {
+                fwrite(buffer, 1, length, link_stats);
+            }
+        }
+        if (data[w] != NULL) {
+            fclose(data[w]);
+        }
+        if (index[w] != NULL) {
+            fclose(index[w]);
+        }
+        if (stats[w] != NULL) {
+            fclose(stats[w]);
+        }
+    }
+    if (link_stats != NULL) {
+        fclose(link_stats);
+    }
+    free(data);
+    free(index);
+    free(stats);
+    munmap(ring.failed, ring.size);
+
+    if (result < 0) {
+        return -1;
+    }
+    int replayed = 0;
+    for (int i = 0; i < replay_line_total(trace, config); i++) {
+        replayed += replay_source(swarm, trace, config, i) >= 0;
+    }
+    return replayed;
+}
@@ -0,0 +1,26 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+
+#include "node.h"
+
+
+typedef struct {
+    int lineLimit;                  // replay only the first lines of the trace, 0 replays all of it
+    int rangingPeriodRate;          // RANGING_PERIOD_RATE unless overridden
+    uint64_t windowStart;           // lines before this system_time are warm-up, their outputs are marked [warmup]
+    int workers;                    // shards replaying the swarm in parallel, 0 or 1 replays sequentially
+    FILE **output;                  // stream the distance sinks write to, each shard writes its own and they are merged into it
+} Replay_Config_t;
+
+typedef struct {
+    Drone_Context_t *context;       // one per address in the trace, ordered by address
+    int count;
+    int16_t *index;                 // UWB_Address_t -> position in context, -1 if absent, ADDRESS_INDEX_SIZE entries
+} Replay_Swarm_t;
+
+
+int replay_swarm_init(Replay_Swarm_t *swarm, const Trace_t *trace);
+void replay_swarm_free(Replay_Swarm_t *swarm);
+int replay_run(Replay_Swarm_t *swarm, const Trace_t *trace, const Replay_Config_t *config);
+#endif
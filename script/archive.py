@@ -0,0 +1,37 @@
+import subprocess
+from contextlib import contextmanager
+
+
+# Readers for text files packed by ../archive (archive.h): traces, sniffer captures, distance logs and vicon.txt
+# are read through `archive cat`, which streams the decoded text, so every reader keeps working on plain lines.
+
+
+ARCHIVE_MAGIC = b"DAR1"
+archive_path = "../archive"
+
+
+def is_archive(path):
+    with open(path, "rb") as f:
+        return f.read(len(ARCHIVE_MAGIC)) == ARCHIVE_MAGIC
+
+
+@contextmanager
+def open_text(path, leftbound=0, rightbound=0):
+    """lines of a text file or of its archive; an archive can be cut to the lines timed in [leftbound, rightbound]"""
+    if not is_archive(path):
+        with open(path, "r", encoding="utf-8") as f:
+            yield f
+        return
+
+    command = [archive_path, "cat", path]
+    if leftbound:
+        command += ["-f", str(leftbound)]
+    if rightbound:
+        command += ["-t", str(rightbound)]
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, text=True, encoding="utf-8", bufsize=1 << 20)
+    try:
+        yield process.stdout
+    finally:
+        process.stdout.close()
+        if process.wait() not in (0, -13):     # SIGPIPE when the reader stopped early
+            raise RuntimeError(f"{archive_path} cat {path} failed")
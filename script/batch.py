@@ -0,0 +1,160 @@
+import os
+import re
+import csv
+import argparse
+import subprocess
+import numpy as np
+from concurrent.futures import ProcessPoolExecutor, as_completed
+
+# This script replays a whole corpus of flights with ../sim and scores every one against its ground truth.
+# The manifest lists one flight per row (name,trace,vicon[,window]); the longest traces are started first so
+# the last replays running are short ones, and every flight writes into its own directory under --output.
+# A flight without ground truth (empty vicon column) is replayed and counted, but reported as unscored.
+
+
+manifest_path = "../data/manifest.csv"
+output_path = "../data/batch"
+sim_path = "../sim"
+warmup = 2000                   # REPLAY_WARMUP in support.h
+invalid_sign = -1
+
+line_pattern = re.compile(r"^(\[warmup\] )?\[local_(\d+) <- neighbor_(\d+)\]: \w+ dist = (-?\d+(?:\.\d+)?), time = \d+(?:, sys_time = \d+)?(?:, vicon = (-?\d+(?:\.\d+)?))?")
+
+
+def read_manifest(path):
+    # trace and vicon paths are relative to the manifest, vicon and window may be left empty
+    base = os.path.dirname(os.path.abspath(path))
+    flights = []
+    with open(path, "r", encoding="utf-8") as f:
+        for row in csv.DictReader(f):
+            flight = {
+                "name": row["name"].strip(),
+                "trace": os.path.join(base, row["trace"].strip()),
+                "vicon": os.path.join(base, row["vicon"].strip()) if (row.get("vicon") or "").strip() else None,
+                "window": (row.get("window") or "").strip() or None,
+            }
+            if any(flight["name"] == other["name"] for other in flights):
+                raise SystemExit(f"duplicate flight {flight['name']} in {path}")
+            flights.append(flight)
+    return flights
+
+def replay(flight, args):
+    # isolated paths: nothing is shared between two replays but the sim binary
+    directory = os.path.join(args.output, flight["name"])
+    os.makedirs(directory, exist_ok=True)
+    distance = os.path.join(directory, "distance.txt")
+    command = [args.sim, "-t", flight["trace"], "-o", distance, "-s", os.path.join(directory, "link_stats.csv")]
+    if flight["vicon"]:
+        command += ["-q", flight["vicon"]]
+    if flight["window"]:
+        command += ["-R", flight["window"], "-u", str(args.warmup)]
+
+    with open(os.path.join(directory, "sim.log"), "w") as log:
+        result = subprocess.run(command, stdout=log, stderr=subprocess.STDOUT)
+    if result.returncode != 0:
+        return flight["name"], None
+    return flight["name"], read_errors(distance)
+
+def read_errors(path):
+    # per link: number of distances, invalid ones and the errors of those written with their ground truth (query mode)
+    links = {}
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            match = line_pattern.match(line)
+            if not match or match.group(1):
+                continue
+            link = links.setdefault((int(match.group(2)), int(match.group(3))), [0, 0, []])
+            link[0] += 1
+            value = float(match.group(4))
+            if value == invalid_sign:
+                link[1] += 1
+            elif match.group(5) is not None:
+                link[2].append(value - float(match.group(5)))
+    return {link: (count, invalid, np.array(errors)) for link, (count, invalid, errors) in links.items()}
+
+def metrics(samples, invalid, errors):
+    if errors.size == 0:
+        return {"samples": samples, "invalid": invalid, "scored": 0, "bias": np.nan, "mae": np.nan, "rmse": np.nan, "p90": np.nan}
+    return {
+        "samples": samples,
+        "invalid": invalid,
+        "scored": errors.size,
+        "bias": float(np.mean(errors)),
+        "mae": float(np.mean(np.abs(errors))),
+        "rmse": float(np.sqrt(np.mean(errors ** 2))),
+        "p90": float(np.percentile(np.abs(errors), 90)),
+    }
+
+def reduce(flights, results):
+    # one row per flight and one for the whole corpus, errors pooled over every link
+    rows = []
+    pooled_samples = 0
+    pooled_invalid = 0
+    pooled_errors = []
+    for flight in flights:
+        links = results.get(flight["name"])
+        if links is None:
+            rows.append({"flight": flight["name"], "status": "failed", "links": 0, **metrics(0, 0, np.zeros(0))})
+            continue
+        samples = sum(count for count, _, _ in links.values())
+        invalid = sum(count for _, count, _ in links.values())
+        errors = np.concatenate([e for _, _, e in links.values()]) if links else np.zeros(0)
+        pooled_samples += samples
+        pooled_invalid += invalid
+        pooled_errors.append(errors)
+        # no ground truth, or none of its instants fell on a replayed link: there is nothing to score
+        status = "ok" if errors.size > 0 else "unscored"
+        rows.append({"flight": flight["name"], "status": status, "links": len(links), **metrics(samples, invalid, errors)})
+
+    errors = np.concatenate(pooled_errors) if pooled_errors else np.zeros(0)
+    links = sum(row["links"] for row in rows)
+    scored = sum(row["status"] == "ok" for row in rows)
+    rows.append({"flight": "overall", "status": f"{scored}/{len(rows)} ok", "links": links, **metrics(pooled_samples, pooled_invalid, errors)})
+    return rows
+
+def write_report(path, rows):
+    with open(path, "w", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()))
+        writer.writeheader()
+        writer.writerows(rows)
+
+def print_report(rows):
+    print(f"\n{'flight':<20}{'status':<10}{'links':>6}{'samples':>10}{'invalid':>9}{'scored':>10}{'bias':>10}{'mae':>10}{'rmse':>10}{'p90':>10}")
+    for row in rows:
+        print(f"{row['flight']:<20}{row['status']:<10}{row['links']:>6}{row['samples']:>10}{row['invalid']:>9}{row['scored']:>10}"
+              f"{row['bias']:>10.4f}{row['mae']:>10.4f}{row['rmse']:>10.4f}{row['p90']:>10.4f}")
+
+def main():
+    parser = argparse.ArgumentParser(description="replay every flight of a manifest in parallel and report the ranging error")
+    parser.add_argument("manifest", nargs="?", default=manifest_path, help="CSV with name,trace,vicon[,window]")
+    parser.add_argument("--output", default=output_path, help="one directory per flight and report.csv are written here")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("--sim", default=sim_path)
+    parser.add_argument("--warmup", type=int, default=warmup, help="warm-up in ms before a window")
+    args = parser.parse_args()
+
+    flights = read_manifest(args.manifest)
+    for flight in flights:
+        if not os.path.exists(flight["trace"]):
+            raise SystemExit(f"{flight['name']}: {flight['trace']} does not exist")
+    os.makedirs(args.output, exist_ok=True)
+
+    # longest first: trace size stands in for replay time, so the stragglers are the small flights
+    order = sorted(flights, key=lambda flight: os.path.getsize(flight["trace"]), reverse=True)
+    print(f"{len(flights)} flights, {args.jobs} jobs")
+
+    results = {}
+    with ProcessPoolExecutor(max_workers=args.jobs) as pool:
+        futures = [pool.submit(replay, flight, args) for flight in order]
+        for future in as_completed(futures):
+            name, links = future.result()
+            results[name] = links
+            print(f"{name}: {'failed, see sim.log' if links is None else f'{len(links)} links'}")
+
+    rows = reduce(flights, results)
+    write_report(os.path.join(args.output, "report.csv"), rows)
+    print_report(rows)
+    return 0 if all(links is not None for links in results.values()) else 1
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -1,3 +1,4 @@
+import argparse
 import re
 import numpy as np
 import pandas as pd
@@ -8,6 +9,8 @@ import pandas as pd
 
 # Number of drones in the simulation.
 DRONE_NUM = 2
+# List only the receivers that heard each message, after an rx_num column, instead of DRONE_NUM - 1 pairs.
+SPARSE = False
 
 
 # get number of Txi and Rxi from the header of the sniffer data file by seq
@@ -48,6 +51,11 @@ def get_drones_addr(file_path):
 
 
 if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="convert sniffer data into the simulation trace")
+    parser.add_argument("--sparse", action="store_true", default=SPARSE,
+                        help="write system_time,src_addr,msg_seq,filter,Tx_time,rx_num,Rx0_addr,Rx0_time,... with heard receivers only")
+    args = parser.parse_args()
+
     buffer_size = 5 * DRONE_NUM
     buffer_pos = 0
     sniffer_data_path = '../data/raw_sensor_data.csv'
@@ -71,8 +79,12 @@ if __name__ == '__main__':
 
     with open(processed_data_path, 'w') as out_file:
         out_file.write("system_time,src_addr,msg_seq,filter,Tx_time")
-        for i in range(DRONE_NUM - 1):
-            out_file.write(f",Rx{i}_addr,Rx{i}_time")
+        if args.sparse:
+            # receiver pairs repeat after the declared one, as many as rx_num says
+            out_file.write(",rx_num,Rx0_addr,Rx0_time")
+        else:
+            for i in range(DRONE_NUM - 1):
+                out_file.write(f",Rx{i}_addr,Rx{i}_time")
         out_file.write('\n')
 
     processed_count = 0
@@ -132,7 +144,12 @@ if __name__ == '__main__':
                             f"{msg_seq[current_pos]},{filter[current_pos]},"
                             f"{Tx_time[current_pos]}"
                         )
-                        for j in range(DRONE_NUM - 1):
+                        if args.sparse:
+                            heard = [j for j in range(DRONE_NUM - 1) if Rx_time[current_pos, j] != 0]
+                            outfile.write(f",{len(heard)}")
+                        else:
+                            heard = range(DRONE_NUM - 1)
+                        for j in heard:
                             outfile.write(f",{Rx_addr[current_pos, j]},{Rx_time[current_pos, j]}")
                         outfile.write('\n')
                     output_count += 1
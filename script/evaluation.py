@@ -6,6 +6,8 @@ import matplotlib
 import matplotlib.pyplot as plt
 matplotlib.use('TkAgg')
 from scipy.stats import gaussian_kde
+from ground_truth import is_store, read_ground_truth
+from archive import open_text
 
 # This script integrates the processed SR and DSR data, aligns them with the VICON timestamps, and then evaluates the data.
 
@@ -50,15 +52,20 @@ sr_error_color = '#a7d3ff'      # 蓝色浅色
 dsr_ic_error_color  = '#ffc0b7' # 红色浅色
 dsr_error_color  = '#fedb9b'    # 黄色浅色
 
+def skip_warmup(lines):
+    # lines of the warm-up before a replay window (center/sim -R) are not evaluated
+    return (line for line in lines if not line.startswith("[warmup]"))
+
 def align_sys_time(time_list):
     if REAL_TIME_ENABLE:
         sys_time = []
         rx_time = []
         align_sys_time = []
-        with open(sys_path, 'r', encoding='utf-8') as f:
+        with open_text(sys_path) as f:
             reader = csv.DictReader(f)
             for row in reader:
-                if int(row['Rx0_addr']) == local_address:
+                # a sparse trace has no Rx0 on lines nobody heard
+                if row['Rx0_addr'] and int(row['Rx0_addr']) == local_address:
                     sys_time.append(int(row['system_time']))
                     rx_time.append(int(row['Rx0_time']))
         index = 0
@@ -82,9 +89,11 @@ def align_sys_time(time_list):
         sys_time = []
         rx_time = []
         align_sys_time = []
-        with open(sys_path, 'r', encoding='utf-8') as f:
+        with open_text(sys_path) as f:
             reader = csv.DictReader(f)
             for row in reader:
+                if not row['Rx0_time']:
+                    continue
                 sys_time.append(int(row['system_time']))
                 rx_time.append(int(row['Rx0_time']))
         index = 0
@@ -102,8 +111,8 @@ def read_ieee_log():
     ieee_time = []
     pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: IEEE dist = (-?\d+(?:\.\d+)?), time = (\d+)")
 
-    with open(ieee_path, "r", encoding="utf-8") as f:
-        for line in f:
+    with open_text(ieee_path) as f:
+        for line in skip_warmup(f):
             if (match := pattern.search(line)):
                 ieee_value.append(float(match.group(1)))
                 ieee_time.append(int(match.group(2)))
@@ -116,8 +125,8 @@ def read_sr_v1_log():
     sr_v1_time = []
     pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: SR_V1 dist = (-?\d+), time = (\d+)")
 
-    with open(sr_v1_path, "r", encoding="utf-8") as f:
-        for i, line in enumerate(f):
+    with open_text(sr_v1_path) as f:
+        for i, line in enumerate(skip_warmup(f)):
             if i < 3:
                 continue
             if (match := pattern.search(line)):
@@ -133,8 +142,8 @@ def read_sr_v2_log():
     # pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: SR_V2 dist = (-?\d+), time = (\d+)")
     pattern = re.compile(rf"\[local_{local_address} <- neighbor_{neighbor_address}\]: SR_V2 dist = (-?\d+(?:\.\d+)?), time = (\d+)")
 
-    with open(sr_v2_path, "r", encoding="utf-8") as f:
-        for i, line in enumerate(f):
+    with open_text(sr_v2_path) as f:
+        for i, line in enumerate(skip_warmup(f)):
             if i < 3:
                 continue
             if (match := pattern.search(line)):
@@ -149,8 +158,8 @@ def read_dsr_log():
     dsr_time = []
     pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: DSR dist = (-?\d+\.\d+), time = (\d+)")
 
-    with open(dsr_path, "r", encoding="utf-8") as f:
-        for i, line in enumerate(f):
+    with open_text(dsr_path) as f:
+        for i, line in enumerate(skip_warmup(f)):
             if i < 3:
                 continue
             if (match := pattern.search(line)):
@@ -165,8 +174,8 @@ def read_cdsr_log():
     cdsr_time = []
     pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: CDSR dist = (-?\d+\.\d+), time = (\d+)")
 
-    with open(cdsr_path, "r", encoding="utf-8") as f:
-        for i, line in enumerate(f):
+    with open_text(cdsr_path) as f:
+        for i, line in enumerate(skip_warmup(f)):
             if i < 3:
                 continue
             if (match := pattern.search(line)):
@@ -177,11 +186,16 @@ def read_cdsr_log():
     return cdsr_value, cdsr_time, cdsr_sys_time
 
 def read_vicon_log(): 
+    # a vicon.gt store answers for any link without scanning every pair
+    if is_store(vicon_path):
+        vicon_value, vicon_time = read_ground_truth(vicon_path, local_address, neighbor_address)
+        return vicon_value.tolist(), vicon_time.tolist()
+
     vicon_value = []
     vicon_time = []
     pattern = re.compile(rf"\[local_(?:{local_address}) <- neighbor_(?:{neighbor_address})\]: vicon dist = (-?\d+\.\d+), time = (\d+)")
     
-    with open(vicon_path, "r", encoding="utf-8") as f:
+    with open_text(vicon_path) as f:
         for line in f:
             if (match := pattern.search(line)):
                 vicon_value.append(float(match.group(1)))
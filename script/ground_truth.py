@@ -0,0 +1,147 @@
+import argparse
+import struct
+import numpy as np
+
+
+# Binary ground-truth store of per-body VICON positions, the counterpart of gt.h.
+# Storage is O(N) per frame; the distance of any pair is interpolated on demand instead of written for every pair.
+
+
+GT_MAGIC = b"DGT1"
+GT_INDEX_MAGIC = b"DGTI"
+GT_VERSION = 1
+GT_BLOCK_FRAMES = 256
+
+header_format = "<4sIII16x"                 # Gt_Header_t
+block_format = "<QQQII"                     # Gt_Block_t
+footer_format = "<QI4s"                     # Gt_Footer_t
+gt_path = "../data/vicon.gt"
+
+
+def address_size(body_count):
+    return (body_count * 2 + 7) & ~7
+
+
+class GroundTruthWriter:
+    """Streams frames of body positions in m; the block index is written by close()."""
+
+    def __init__(self, path, bodies, block_frames=GT_BLOCK_FRAMES):
+        self.bodies = sorted(int(body) for body in bodies)
+        self.block_frames = block_frames
+        self.file = open(path, "wb")
+        self.file.write(struct.pack(header_format, GT_MAGIC, GT_VERSION, len(self.bodies), block_frames))
+        self.file.write(struct.pack(f"<{len(self.bodies)}H", *self.bodies).ljust(address_size(len(self.bodies)), b"\0"))
+        self.frame_format = f"<Q{3 * len(self.bodies)}f"
+        self.blocks = []
+        self.frames = 0
+
+    def add_frame(self, system_time, positions):
+        """positions maps every body to its (x, y, z) in m"""
+        if not self.blocks or self.blocks[-1][4] == self.block_frames:
+            self.blocks.append([system_time, system_time, self.file.tell(), self.frames, 0])
+        block = self.blocks[-1]
+        block[1] = system_time
+        block[4] += 1
+        values = [value for body in self.bodies for value in positions[body]]
+        self.file.write(struct.pack(self.frame_format, system_time, *values))
+        self.frames += 1
+
+    def close(self):
+        index_offset = (self.file.tell() + 7) & ~7
+        self.file.write(b"\0" * (index_offset - self.file.tell()))
+        for block in self.blocks:
+            self.file.write(struct.pack(block_format, *block))
+        self.file.write(struct.pack(footer_format, index_offset, len(self.blocks), GT_INDEX_MAGIC))
+        self.file.close()
+
+
+class GroundTruth:
+    """Read-only view of a store, distances in cm interpolated linearly between frames."""
+
+    def __init__(self, path):
+        self.data = np.memmap(path, dtype=np.uint8, mode="r")
+        magic, version, body_count, _ = struct.unpack_from(header_format, self.data, 0)
+        index_offset, block_count, index_magic = struct.unpack_from(footer_format, self.data, len(self.data) - struct.calcsize(footer_format))
+        if magic != GT_MAGIC or version != GT_VERSION or index_magic != GT_INDEX_MAGIC:
+            raise ValueError(f"{path} is not a ground-truth store")
+
+        self.bodies = np.frombuffer(self.data, dtype="<u2", count=body_count, offset=struct.calcsize(header_format))
+        frame_dtype = np.dtype([("time", "<u8"), ("position", "<f4", (body_count, 3))])
+        block_dtype = np.dtype([("first_time", "<u8"), ("last_time", "<u8"), ("offset", "<u8"), ("first_frame", "<u4"), ("frame_count", "<u4")])
+        self.blocks = np.frombuffer(self.data, dtype=block_dtype, count=block_count, offset=index_offset)
+        self.frames = [np.frombuffer(self.data, dtype=frame_dtype, count=int(block["frame_count"]), offset=int(block["offset"]))
+                       for block in self.blocks]
+
+    def body(self, address):
+        index = np.searchsorted(self.bodies, address)
+        if index == len(self.bodies) or self.bodies[index] != address:
+            raise KeyError(f"body {address} is not in the store")
+        return index
+
+    def frame_times(self, leftbound=0, rightbound=0):
+        """system_time of every frame within [leftbound, rightbound], rightbound 0 keeps everything"""
+        first = np.searchsorted(self.blocks["last_time"], leftbound)
+        last = len(self.blocks) if rightbound == 0 else np.searchsorted(self.blocks["first_time"], rightbound, side="right")
+        if first >= last:
+            return np.zeros(0, dtype=np.uint64)
+        times = np.concatenate([frames["time"] for frames in self.frames[first:last]])
+        return times[(times >= leftbound) & ((rightbound == 0) | (times <= rightbound))]
+
+    def positions(self, address, system_time):
+        """(len(system_time), 3) positions in m, NaN outside the recorded frames"""
+        body = self.body(address)
+        system_time = np.atleast_1d(np.asarray(system_time, dtype=np.uint64))
+        result = np.full((len(system_time), 3), np.nan)
+
+        # the block index narrows every instant to one block, two frames of it are interpolated
+        block = np.searchsorted(self.blocks["last_time"], system_time)
+        for b in np.unique(block[block < len(self.blocks)]):
+            selected = block == b
+            frames = self.frames[b]
+            times = frames["time"]
+            position = frames["position"][:, body, :].astype(np.float64)
+            if b > 0:
+                previous = self.frames[b - 1][-1]
+                times = np.concatenate([[previous["time"]], times])
+                position = np.concatenate([previous["position"][body][None, :].astype(np.float64), position])
+            t = system_time[selected]
+            right = np.searchsorted(times, t)
+            left = np.where(times[right] == t, right, np.maximum(right - 1, 0))
+            span = (times[right] - times[left]).astype(np.float64)
+            weight = np.divide((t - times[left]).astype(np.float64), span, out=np.zeros(len(t)), where=span > 0)
+            value = position[left] + weight[:, None] * (position[right] - position[left])
+            value[t < times[0]] = np.nan
+            result[selected] = value
+        return result
+
+    def distance(self, local, neighbor, system_time):
+        """distance in cm between two bodies at one or many instants, NaN outside the recorded frames"""
+        delta = self.positions(local, system_time) - self.positions(neighbor, system_time)
+        distance = np.sqrt((delta ** 2).sum(axis=1)) * 100      # m -> cm, as in vicon.txt
+        return distance if np.ndim(system_time) else distance[0]
+
+
+def is_store(path):
+    with open(path, "rb") as f:
+        return f.read(len(GT_MAGIC)) == GT_MAGIC
+
+
+def read_ground_truth(path, local, neighbor, leftbound=0, rightbound=0):
+    """(distance, time) of one link at every frame, the layout read_vicon_log returns for vicon.txt"""
+    store = GroundTruth(path)
+    times = store.frame_times(leftbound, rightbound)
+    return store.distance(local, neighbor, times), times
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="query a ground-truth store written by vicon.py")
+    parser.add_argument("path", nargs="?", default=gt_path)
+    parser.add_argument("--local", type=int, required=True)
+    parser.add_argument("--neighbor", type=int, required=True)
+    parser.add_argument("--time", type=int, nargs="*", help="instants to evaluate, every frame if omitted")
+    args = parser.parse_args()
+
+    store = GroundTruth(args.path)
+    times = np.array(args.time, dtype=np.uint64) if args.time else store.frame_times()
+    for t, d in zip(times, store.distance(args.local, args.neighbor, times)):
+        print(f"[local_{args.local} <- neighbor_{args.neighbor}]: vicon dist = {d:.4f}, time = {t}")
@@ -0,0 +1,142 @@
+import ctypes
+import numpy as np
+
+
+# In-process replay through ../libreplay.so (libreplay.h): the trace is loaded once, every run returns its distances
+# as numpy arrays viewing the buffers the library filled, so nothing is copied or parsed from text. The buffers of a
+# run are freed when the last of its arrays is.
+
+
+library_path = "../libreplay.so"
+library_version = 1             # LIBREPLAY_VERSION in libreplay.h
+warmup = 2000                   # REPLAY_WARMUP in support.h
+
+
+class Options(ctypes.Structure):
+    _fields_ = [("lineLimit", ctypes.c_int), ("rangingPeriodRate", ctypes.c_int), ("packetLoss", ctypes.c_double), ("checkPoint", ctypes.c_int)]
+
+
+class Link(ctypes.Structure):
+    _fields_ = [
+        ("local", ctypes.c_uint16), ("neighbor", ctypes.c_uint16), ("reserved", ctypes.c_uint32),
+        ("received", ctypes.c_uint64), ("lost", ctypes.c_uint64), ("zeroTimestamp", ctypes.c_uint64),
+        ("distanceValid", ctypes.c_uint64), ("distanceInvalid", ctypes.c_uint64),
+    ]
+
+
+class Result(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_int64),
+        ("local", ctypes.c_void_p),
+        ("neighbor", ctypes.c_void_p),
+        ("distance", ctypes.c_void_p),
+        ("timestamp", ctypes.c_void_p),
+        ("systemTime", ctypes.c_void_p),
+        ("truth", ctypes.c_void_p),
+        ("warmup", ctypes.c_void_p),
+        ("link", ctypes.c_void_p),
+        ("linkCount", ctypes.c_int64),
+        ("replayed", ctypes.c_int64),
+        ("capacity", ctypes.c_int64),
+    ]
+
+
+link_dtype = np.dtype([(name, np.dtype(ctype)) for name, ctype in Link._fields_])
+
+
+class Owner:
+    # one Libreplay_Result_t, freed by the library once no array refers to it
+    def __init__(self, library, pointer):
+        self.library = library
+        self.pointer = pointer
+
+    def __del__(self):
+        self.library.libreplay_result_free(self.pointer)
+
+
+class Column:
+    # numpy keeps the object exposing __array_interface__ as the base of the array, and with it the owner
+    def __init__(self, owner, address, count, dtype):
+        self.owner = owner
+        self.__array_interface__ = {"data": (address or 0, True), "shape": (count,), "typestr": np.dtype(dtype).str,
+                                    "descr": np.dtype(dtype).descr, "version": 3}
+
+
+def view(owner, address, count, dtype):
+    if count == 0:
+        return np.zeros(0, dtype=dtype)
+    return np.asarray(Column(owner, address, count, dtype))
+
+
+_library = None
+
+def load_library(path=library_path):
+    global _library
+    if _library is None:
+        library = ctypes.CDLL(path)
+        library.libreplay_version.restype = ctypes.c_int
+        library.libreplay_mode.restype = ctypes.c_char_p
+        library.libreplay_open.restype = ctypes.c_void_p
+        library.libreplay_open.argtypes = [ctypes.c_char_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64]
+        library.libreplay_query.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64, ctypes.c_uint64]
+        library.libreplay_run.restype = ctypes.POINTER(Result)
+        library.libreplay_run.argtypes = [ctypes.c_void_p, ctypes.POINTER(Options)]
+        library.libreplay_result_free.argtypes = [ctypes.POINTER(Result)]
+        library.libreplay_close.argtypes = [ctypes.c_void_p]
+        if library.libreplay_version() != library_version:
+            raise RuntimeError(f"{path} implements libreplay {library.libreplay_version()}, expected {library_version}")
+        _library = library
+    return _library
+
+class Replay:
+    """a loaded trace, replayed in this process as sim -t trace [-R window_start:window_end -u warmup] [-q query]"""
+
+    def __init__(self, trace, window=None, warmup=warmup, query=None, bounds=(0, 0), library=library_path):
+        self.library = load_library(library)
+        start, end = window or (0, 0)
+        self.handle = self.library.libreplay_open(trace.encode(), start, end, warmup)
+        if not self.handle:
+            raise RuntimeError(f"failed to load {trace}")
+        if query is not None:
+            self.query(query, *bounds)
+
+    @property
+    def mode(self):
+        return self.library.libreplay_mode().decode()
+
+    def query(self, path, leftbound=0, rightbound=0):
+        # vicon.txt or vicon.gt, None goes back to CHECK_POINT sampling
+        if self.library.libreplay_query(self.handle, path.encode() if path else None, leftbound, rightbound) < 0:
+            raise RuntimeError(f"failed to load {path}")
+
+    def run(self, lines=0, rate=0, loss=-1.0, check_point=0):
+        """dict of columns local, neighbor, distance, timestamp, system_time, truth, warmup and links, a structured
+        array of the link counters; all of them view the buffers of this run"""
+        options = Options(lines, rate, loss, check_point)
+        pointer = self.library.libreplay_run(self.handle, ctypes.byref(options))
+        if not pointer:
+            raise RuntimeError("replay failed")
+        owner = Owner(self.library, pointer)
+        result = pointer.contents
+        return {
+            "local": view(owner, result.local, result.count, np.uint16),
+            "neighbor": view(owner, result.neighbor, result.count, np.uint16),
+            "distance": view(owner, result.distance, result.count, np.float64),
+            "timestamp": view(owner, result.timestamp, result.count, np.uint64),
+            "system_time": view(owner, result.systemTime, result.count, np.uint64),
+            "truth": view(owner, result.truth, result.count, np.float64),
+            "warmup": view(owner, result.warmup, result.count, np.bool_),
+            "links": view(owner, result.link, result.linkCount, link_dtype),
+            "replayed": result.replayed,
+        }
+
+    def close(self):
+        if self.handle:
+            self.library.libreplay_close(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -0,0 +1,41 @@
+import argparse
+import pandas as pd
+
+# This script reads the per-link counters written by drone (LINK_STATS_PERIOD) or sim (-s) and flags
+# pathological links from the latest snapshot, so long sweeps can be checked without the distance logs.
+
+
+link_stats_path = "../data/log/compensate_links_1.csv"
+max_lost_rate = 0.2             # share of received messages dropped by PACKET_LOSS
+max_zero_rate = 0.05            # share of received messages with a zero Rx timestamp
+max_invalid_rate = 0.1          # share of sampled distances the library could not compute
+
+
+def latest_snapshot(path):
+    data = pd.read_csv(path)
+    return data[data["snapshot"] == data["snapshot"].max()].copy()
+
+def main():
+    parser = argparse.ArgumentParser(description="flag pathological links in a link counter snapshot")
+    parser.add_argument("paths", nargs="*", default=[link_stats_path])
+    parser.add_argument("--max-lost", type=float, default=max_lost_rate)
+    parser.add_argument("--max-zero", type=float, default=max_zero_rate)
+    parser.add_argument("--max-invalid", type=float, default=max_invalid_rate)
+    parser.add_argument("--all", action="store_true", help="print every link, not only the flagged ones")
+    args = parser.parse_args()
+
+    links = pd.concat([latest_snapshot(path) for path in args.paths], ignore_index=True)
+    received = links["received"].clip(lower=1)
+    sampled = (links["distance_valid"] + links["distance_invalid"]).clip(lower=1)
+    links["lost_rate"] = links["lost"] / received
+    links["zero_rate"] = links["zero_timestamp"] / received
+    links["invalid_rate"] = links["distance_invalid"] / sampled
+    flagged = (links["lost_rate"] > args.max_lost) | (links["zero_rate"] > args.max_zero) | (links["invalid_rate"] > args.max_invalid)
+
+    columns = ["local", "neighbor", "received", "lost_rate", "zero_rate", "invalid_rate", "tx_wraparounds", "rx_wraparounds"]
+    shown = links if args.all else links[flagged]
+    print(shown.sort_values(["local", "neighbor"])[columns].to_string(index=False, float_format=lambda x: f"{x:.3f}"))
+    print(f"\n{int(flagged.sum())} of {len(links)} links flagged")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,278 @@
+import os
+import re
+import json
+import shutil
+import hashlib
+import argparse
+import itertools
+import subprocess
+import numpy as np
+from concurrent.futures import ProcessPoolExecutor
+
+from ground_truth import is_store, read_ground_truth
+from archive import open_text
+
+# This script runs ../sim for one configuration or a sweep of configurations and caches the results.
+# A run is keyed by the hash of the trace content, the effective configuration and the sim binary (which
+# carries the ranging mode, the ranging library build and every compile-time macro), so unchanged runs are
+# served from ../data/cache and sweeps only simulate the points that are missing.
+
+
+local_address = 2
+neighbor_address = 3
+invalid_sign = -1
+
+sim_path = "../sim"
+support_path = "../support.h"
+sys_path = "../data/simulation_dep.csv"
+vicon_path = "../data/vicon.txt"
+cache_path = "../data/cache"
+
+# runtime option of sim for every configuration macro of support.h
+config_options = {
+    "PACKET_LOSS": "-l",
+    "CHECK_POINT": "-c",
+    "RANGING_PERIOD_RATE": "-r",
+}
+
+
+def read_vicon_log(path, local, neighbor):
+    # a vicon.gt store answers for any link without scanning every pair
+    if is_store(path):
+        return read_ground_truth(path, local, neighbor)
+
+    vicon_value = []
+    vicon_time = []
+    pattern = re.compile(rf"\[local_{local} <- neighbor_{neighbor}\]: vicon dist = (-?\d+\.\d+), time = (\d+)")
+
+    with open_text(path) as f:
+        for line in f:
+            if (match := pattern.search(line)):
+                vicon_value.append(float(match.group(1)))
+                vicon_time.append(int(match.group(2)))
+
+    order = np.argsort(vicon_time)
+    return np.array(vicon_value)[order], np.array(vicon_time)[order]
+
+def read_sim_log(path, local, neighbor):
+    # lines written in query mode carry the ground truth of their instant, other lines get nan
+    value = []
+    sys_time = []
+    truth = []
+    pattern = re.compile(rf"\[local_{local} <- neighbor_{neighbor}\]: \w+ dist = (-?\d+(?:\.\d+)?), time = \d+, sys_time = (\d+)(?:, vicon = (-?\d+(?:\.\d+)?))?")
+
+    with open_text(path) as f:
+        for line in f:
+            # warm-up lines of a windowed replay are not evaluated
+            if line.startswith("[warmup]"):
+                continue
+            if (match := pattern.search(line)):
+                value.append(float(match.group(1)))
+                sys_time.append(int(match.group(2)))
+                truth.append(float(match.group(3)) if match.group(3) else np.nan)
+
+    return np.array(value), np.array(sys_time), np.array(truth)
+
+def nearest_vicon(vicon, vicon_time, sys_time):
+    idx = np.clip(np.searchsorted(vicon_time, sys_time), 1, len(vicon_time) - 1)
+    left = vicon_time[idx - 1]
+    right = vicon_time[idx]
+    idx -= (sys_time - left) < (right - sys_time)
+    return vicon[idx]
+
+def align_truth(sys_time, truth, vicon, vicon_time):
+    missing = np.isnan(truth)
+    if missing.any() and vicon.size > 0:
+        truth = truth.copy()
+        truth[missing] = nearest_vicon(vicon, vicon_time, sys_time[missing])
+    return truth
+
+def sim_default(name, value):
+    # sim runs with rate 1 below 1 (replay.c); CHECK_POINT 0 samples nothing, as in the drones
+    if name == "RANGING_PERIOD_RATE" and value <= 0:
+        return 1.0
+    return value
+
+def read_support_config(path):
+    # the values sim runs with when support.h is left as it is, so forwarding them changes nothing
+    config = {}
+    pattern = re.compile(r"^#define\s+(\w+)\s+([-\d.]+)")
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            if (match := pattern.match(line)) and match.group(1) in config_options:
+                config[match.group(1)] = sim_default(match.group(1), float(match.group(2)))
+    return config
+
+def file_hash(path, memo=None):
+    # hashing a large trace dominates cache hits, so the digest is remembered by path, size and mtime
+    stat = os.stat(path)
+    memo_key = f"{os.path.abspath(path)}:{stat.st_size}:{stat.st_mtime_ns}"
+    if memo is not None and memo_key in memo:
+        return memo[memo_key]
+
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            digest.update(block)
+    if memo is not None:
+        memo[memo_key] = digest.hexdigest()
+    return digest.hexdigest()
+
+def load_memo(cache):
+    try:
+        with open(os.path.join(cache, "hash_memo.json"), "r", encoding="utf-8") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+def save_memo(cache, memo):
+    os.makedirs(cache, exist_ok=True)
+    tmp = os.path.join(cache, f"hash_memo.json.{os.getpid()}")
+    with open(tmp, "w", encoding="utf-8") as f:
+        json.dump(memo, f)
+    os.replace(tmp, os.path.join(cache, "hash_memo.json"))
+
+def run_key(trace_hash, engine_hash, config, link, truth_hash):
+    # the metrics are those of one link against one ground truth, so both belong to the key with the distance log
+    text = json.dumps({"trace": trace_hash, "engine": engine_hash, "config": config, "link": link, "truth": truth_hash},
+                      sort_keys=True)
+    return hashlib.sha256(text.encode()).hexdigest()
+
+def entry_path(cache, key):
+    return os.path.join(cache, key[:2], key)
+
+def compute_metrics(distance_path, args):
+    value, sys_time, truth = read_sim_log(distance_path, args.local, args.neighbor)
+    metrics = {"samples": int(value.size), "invalid": int(np.sum(value == invalid_sign))}
+    if not os.path.exists(args.vicon):
+        return metrics
+
+    vicon, vicon_time = read_vicon_log(args.vicon, args.local, args.neighbor)
+    valid = value != invalid_sign
+    truth = align_truth(sys_time[valid], truth[valid], vicon, vicon_time)
+    if not valid.any() or np.isnan(truth).any():
+        return metrics
+    error = value[valid] - truth
+    metrics["mae"] = float(np.mean(np.abs(error)))
+    metrics["rmse"] = float(np.sqrt(np.mean(error ** 2)))
+    metrics["bias"] = float(np.mean(error))
+    return metrics
+
+def simulate(key, config, args):
+    # build the entry next to its final place and publish it with one rename, so concurrent runs never see half of it
+    final = entry_path(args.cache, key)
+    tmp = f"{final}.tmp{os.getpid()}"
+    os.makedirs(tmp, exist_ok=True)
+    distance_path = os.path.join(tmp, "distance.txt")
+
+    command = [args.sim, "-t", args.trace, "-o", distance_path, "-n", str(config["lines"])]
+    for name, option in config_options.items():
+        command += [option, f"{config[name]:g}"]
+    if config.get("query"):
+        command += ["-q", args.vicon]
+    result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0:
+        shutil.rmtree(tmp, ignore_errors=True)
+        raise RuntimeError(f"sim failed: {result.stderr.strip()}")
+
+    metrics = compute_metrics(distance_path, args)
+    with open(os.path.join(tmp, "config.json"), "w", encoding="utf-8") as f:
+        json.dump(config, f, indent=2, sort_keys=True)
+    with open(os.path.join(tmp, "metrics.json"), "w", encoding="utf-8") as f:
+        json.dump(metrics, f, indent=2, sort_keys=True)
+
+    try:
+        os.rename(tmp, final)
+    except OSError:
+        # another run published the same key first
+        shutil.rmtree(tmp, ignore_errors=True)
+    return metrics
+
+def load_cached(key, args):
+    if args.no_cache:
+        return None
+    try:
+        with open(os.path.join(entry_path(args.cache, key), "metrics.json"), "r", encoding="utf-8") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+def parse_sweep(items, parse_name):
+    # NAME=v1,v2,... -> {NAME: [v1, v2, ...]}
+    sweep = {}
+    for item in items or []:
+        name, values = item.split("=", 1)
+        sweep[parse_name(name)] = [float(v) for v in values.split(",")]
+    return sweep
+
+def expand_configs(defaults, sweep, lines):
+    configs = []
+    for point in itertools.product(*sweep.values()):
+        config = {"lines": lines}
+        config.update(defaults)
+        config.update(zip(sweep, point))
+        configs.append(config)
+    return configs
+
+def format_config(config, sweep):
+    fields = [f"{name}={config[name]:g}" for name in sweep]
+    return " ".join(fields) if fields else "default"
+
+def check_option(name):
+    if name not in config_options:
+        raise SystemExit(f"unknown option {name}, expected one of {', '.join(config_options)}")
+    return name
+
+def main():
+    parser = argparse.ArgumentParser(description="run sim with a content-addressed results cache")
+    parser.add_argument("--set", action="append", help="NAME=v1,v2,... for PACKET_LOSS, CHECK_POINT or RANGING_PERIOD_RATE")
+    parser.add_argument("--lines", type=int, default=0, help="replay only the first lines of the trace, 0 replays all")
+    parser.add_argument("--local", type=int, default=local_address)
+    parser.add_argument("--neighbor", type=int, default=neighbor_address)
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("--trace", default=sys_path)
+    parser.add_argument("--vicon", default=vicon_path)
+    parser.add_argument("--sim", default=sim_path)
+    parser.add_argument("--cache", default=cache_path)
+    parser.add_argument("--query", action="store_true", help="evaluate distances only at the VICON sample times")
+    parser.add_argument("--no-cache", action="store_true", help="simulate every point and overwrite nothing")
+    args = parser.parse_args()
+
+    sweep = parse_sweep(args.set, check_option)
+    configs = expand_configs(read_support_config(support_path), sweep, args.lines)
+
+    memo = load_memo(args.cache)
+    trace_hash = file_hash(args.trace, memo)
+    if args.query:
+        # the query schedule is an input of the run, so its content belongs to the key
+        for config in configs:
+            config["query"] = file_hash(args.vicon, memo)
+    engine_hash = file_hash(args.sim, memo)
+    truth_hash = file_hash(args.vicon, memo) if os.path.exists(args.vicon) else None
+    save_memo(args.cache, memo)
+    link = [args.local, args.neighbor]
+    keys = [run_key(trace_hash, engine_hash, config, link, truth_hash) for config in configs]
+
+    results = [load_cached(key, args) for key in keys]
+    missing = [i for i, r in enumerate(results) if r is None]
+    print(f"{len(configs)} runs, {len(configs) - len(missing)} cached, {len(missing)} to simulate")
+
+    if args.no_cache:
+        args.cache = os.path.join(args.cache, f"uncached.{os.getpid()}")
+    with ProcessPoolExecutor(max_workers=args.jobs) as pool:
+        computed = pool.map(simulate, [keys[i] for i in missing], [configs[i] for i in missing], [args] * len(missing))
+        for i, metrics in zip(missing, computed):
+            results[i] = metrics
+    if args.no_cache:
+        shutil.rmtree(args.cache, ignore_errors=True)
+
+    print(f"\n{'source':<8}{'samples':<9}{'rmse':<10}{'mae':<10}{'key':<14}config")
+    for i, (config, metrics) in enumerate(zip(configs, results)):
+        source = "sim" if i in missing else "cache"
+        rmse = f"{metrics['rmse']:.4f}" if "rmse" in metrics else "-"
+        mae = f"{metrics['mae']:.4f}" if "mae" in metrics else "-"
+        print(f"{source:<8}{metrics['samples']:<9}{rmse:<10}{mae:<10}{keys[i][:12]:<14}{format_config(config, sweep)}")
+    print(f"\ndistance logs: {os.path.abspath(args.cache)}/<key[:2]>/<key>/distance.txt")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+import heapq
+import random
+import argparse
+from contextlib import ExitStack
+from archive import open_text
+
+# This script composes a large-swarm trace out of several real flights. The addresses of every flight are remapped
+# into one address space, every flight is shifted onto a common system_time base and its UWB clocks by the same
+# amount modulo UWB_MAX_TIMESTAMP, and the lines are interleaved by system_time into one sparse trace. Inputs are
+# streamed (one pending line per flight), so memory does not grow with the length of the flights.
+
+
+output_path = "../data/scenario.csv"
+uwb_max_timestamp = 1 << 40     # UWB_MAX_TIMESTAMP in support.h
+ticks_per_ms = 63897600         # UWB ticks per ms, 1 / DWT_TIME_UNITS / 1000 in support.h
+address_limit = 65534           # UWB_DEST_EMPTY and above are reserved
+cross_max_age = 1000            # ms a drone's clock is extrapolated from its last own timestamp for a cross-link
+
+header = "system_time,src_addr,msg_seq,filter,Tx_time,rx_num,Rx0_addr,Rx0_time\n"
+
+
+def parse_line(line, sparse):
+    # system_time,src_addr,msg_seq,filter,Tx_time,[rx_num,]Rx0_addr,Rx0_time,... -> receivers that heard the message
+    fields = line.rstrip("\r\n").split(",")
+    first = 6 if sparse else 5
+    end = first + 2 * int(fields[5]) if sparse else len(fields)
+    heard = [(int(fields[i]), int(fields[i + 1])) for i in range(first, end - 1, 2) if fields[i] not in ("", "0") and fields[i + 1] not in ("", "0")]
+    return int(fields[0]), int(fields[1]), fields[2], fields[3], int(fields[4]), heard
+
+def scan_flight(path):
+    # addresses and first system_time of a flight, in one streamed pass
+    addresses = set()
+    first_time = None
+    lines = 0
+    with open_text(path) as f:
+        sparse = "rx_num" in f.readline().rstrip("\r\n").split(",")
+        for line in f:
+            if not line.strip():
+                break
+            system_time, src, _, _, _, heard = parse_line(line, sparse)
+            if first_time is None:
+                first_time = system_time
+            addresses.add(src)
+            addresses.update(address for address, _ in heard)
+            lines += 1
+    addresses.discard(0)
+    return {"path": path, "addresses": sorted(addresses), "first_time": first_time, "lines": lines}
+
+def assign_addresses(flights, stride):
+    # stride 0 numbers the drones of all flights consecutively, otherwise flight k keeps its addresses plus k * stride
+    next_address = 1
+    for k, flight in enumerate(flights):
+        if stride:
+            flight["map"] = {address: k * stride + address for address in flight["addresses"]}
+        else:
+            flight["map"] = {address: next_address + i for i, address in enumerate(flight["addresses"])}
+            next_address += len(flight["addresses"])
+    used = [address for flight in flights for address in flight["map"].values()]
+    if len(set(used)) != len(used):
+        raise SystemExit(f"--stride {stride} maps drones of two flights onto one address")
+    if max(used, default=0) >= address_limit:
+        raise SystemExit(f"address {max(used)} is out of range, use a smaller --stride")
+
+def shift_clock(timestamp, shift):
+    # 0 marks a receiver that did not hear the message, a shifted timestamp must not become one
+    if timestamp == 0:
+        return 0
+    return (timestamp + shift) % uwb_max_timestamp or 1
+
+def flight_lines(f, k, flight):
+    sparse = "rx_num" in f.readline().rstrip("\r\n").split(",")
+    mapping, time_shift, clock_shift = flight["map"], flight["time_shift"], flight["clock_shift"]
+    previous = 0
+    for n, line in enumerate(f):
+        if not line.strip():
+            break
+        system_time, src, seq, filter, tx_time, heard = parse_line(line, sparse)
+        if system_time < previous:
+            flight["unsorted"] += 1
+        previous = system_time
+        heard = [(mapping[address], shift_clock(timestamp, clock_shift)) for address, timestamp in heard]
+        # ties keep flight order, then line order, so the output does not depend on anything but the inputs
+        yield system_time + time_shift, k, n, mapping[src], seq, filter, shift_clock(tx_time, clock_shift), heard
+
+class CrossLinker:
+    """synthetic receptions between flights: with probability `rate` a drone of another flight hears a message, at the
+    time its own clock shows, extrapolated from its last own timestamp. These links load the center and the ranging
+    tables like a large swarm does, but their distances carry no meaning."""
+
+    def __init__(self, flights, rate, seed):
+        self.rate = rate
+        self.random = random.Random(seed)
+        self.flight_of = {address: k for k, flight in enumerate(flights) for address in flight["map"].values()}
+        self.anchor = {}
+        self.links = 0
+
+    def observe(self, system_time, src, tx_time, heard):
+        self.anchor[src] = (system_time, tx_time)
+        for address, timestamp in heard:
+            self.anchor[address] = (system_time, timestamp)
+
+    def extend(self, system_time, k, src, heard):
+        listed = {address for address, _ in heard}
+        extra = []
+        for address, (anchor_time, anchor_timestamp) in self.anchor.items():
+            if self.flight_of[address] == k or address in listed or system_time - anchor_time > cross_max_age:
+                continue
+            if self.random.random() < self.rate:
+                extra.append((address, shift_clock(anchor_timestamp, (system_time - anchor_time) * ticks_per_ms)))
+        self.links += len(extra)
+        return heard + sorted(extra)
+
+def compose(paths, output, stagger, stride, cross_links, seed):
+    flights = []
+    for path in paths:
+        flight = scan_flight(path)
+        if flight["lines"] == 0:
+            print(f"{path}: no lines, skipped")
+            continue
+        flights.append(flight)
+    if not flights:
+        raise SystemExit("no flight to compose")
+    assign_addresses(flights, stride)
+
+    # flight k starts k * stagger ms after the first one; its UWB clocks advance by the same time
+    base = flights[0]["first_time"]
+    for k, flight in enumerate(flights):
+        flight["time_shift"] = base + k * stagger - flight["first_time"]
+        flight["clock_shift"] = flight["time_shift"] * ticks_per_ms % uwb_max_timestamp
+        flight["unsorted"] = 0
+
+    linker = CrossLinker(flights, cross_links, seed) if cross_links > 0 else None
+    written = 0
+    with ExitStack() as stack, open(output, "w", encoding="utf-8") as out:
+        out.write(header)
+        sources = [flight_lines(stack.enter_context(open_text(flight["path"])), k, flight) for k, flight in enumerate(flights)]
+        for system_time, k, _, src, seq, filter, tx_time, heard in heapq.merge(*sources):
+            if linker is not None:
+                linker.observe(system_time, src, tx_time, heard)
+                heard = linker.extend(system_time, k, src, heard)
+            out.write(f"{system_time},{src},{seq},{filter},{tx_time},{len(heard)}")
+            out.write("".join(f",{address},{timestamp}" for address, timestamp in heard))
+            out.write("\n")
+            written += 1
+    return flights, written, linker.links if linker is not None else 0
+
+def main():
+    parser = argparse.ArgumentParser(description="compose one large-swarm trace out of several real flights")
+    parser.add_argument("traces", nargs="+", help="simulation_dep.csv of every flight, dense, sparse or archived")
+    parser.add_argument("--output", default=output_path, help="sparse trace written here")
+    parser.add_argument("--stagger", type=int, default=0, help="ms between the starts of two consecutive flights")
+    parser.add_argument("--stride", type=int, default=0,
+                        help="flight k maps address a to k * stride + a, 0 numbers all drones consecutively from 1")
+    parser.add_argument("--cross-links", type=float, default=0.0,
+                        help="probability that a drone of another flight hears a message, 0 keeps the flights apart")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the cross-links")
+    parser.add_argument("--map", help="write flight,trace,address,mapped_address here, e.g. to rename vicon bodies")
+    args = parser.parse_args()
+    if not 0 <= args.cross_links <= 1 or args.stagger < 0 or args.stride < 0:
+        raise SystemExit("--cross-links must be in [0, 1], --stagger and --stride not negative")
+
+    flights, written, links = compose(args.traces, args.output, args.stagger, args.stride, args.cross_links, args.seed)
+    drones = sum(len(flight["map"]) for flight in flights)
+    for k, flight in enumerate(flights):
+        mapped = flight["map"]
+        print(f"flight {k}: {flight['path']}, {flight['lines']} lines, drones {min(mapped.values())}-{max(mapped.values())}, "
+              f"shifted by {flight['time_shift']} ms")
+        if flight["unsorted"]:
+            print(f"  warning: {flight['unsorted']} lines go back in system_time, the output is not sorted there")
+    print(f"{args.output}: {written} lines, {drones} drones (NODES_NUM = {drones}), {links} cross-link receptions")
+
+    if args.map:
+        with open(args.map, "w", encoding="utf-8") as f:
+            f.write("flight,trace,address,mapped_address\n")
+            for k, flight in enumerate(flights):
+                for address, mapped in flight["map"].items():
+                    f.write(f"{k},{flight['path']},{address},{mapped}\n")
+
+
+if __name__ == "__main__":
+    main()
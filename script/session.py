@@ -0,0 +1,153 @@
+import os
+import csv
+import sys
+import time
+import socket
+import struct
+import argparse
+import subprocess
+
+# This script talks to a center started with -d: it creates sessions, lists them, or runs a whole session
+# (create it, start the drones of the trace with --session and wait for them), so several simulations can
+# share one center.
+
+
+center_ip = "127.0.0.1"
+center_port = 8520
+drone_path = "../drone"
+sys_path = "../data/simulation_dep.csv"
+drones_per_process = 32
+
+# Simu_Message_t: srcAddress[ADDR_SIZE], destAddress[ADDR_SIZE], payload[PAYLOAD_SIZE], size_t size
+ADDR_SIZE = 20
+MESSAGE_SIZE = 512
+PAYLOAD_SIZE = MESSAGE_SIZE - 2 * ADDR_SIZE - 8
+message_format = f"={ADDR_SIZE}s{ADDR_SIZE}s{PAYLOAD_SIZE}sQ"
+
+
+def request(s, command):
+    payload = command.encode()
+    s.sendall(struct.pack(message_format, b"CONTROL", b"CENTER", payload, len(payload) + 1))
+    reply = b""
+    while len(reply) < MESSAGE_SIZE:
+        chunk = s.recv(MESSAGE_SIZE - len(reply))
+        if not chunk:
+            raise SystemExit("center closed the connection")
+        reply += chunk
+    _, _, payload, _ = struct.unpack(message_format, reply)
+    return payload.split(b"\0", 1)[0].decode()
+
+def control(command):
+    with socket.create_connection((center_ip, center_port)) as s:
+        return request(s, command)
+
+def create_session(args):
+    command = f"create trace={os.path.abspath(args.trace)} nodes={args.nodes or len(trace_addresses(args.trace))}"
+    command += f" dilation={args.dilation:g} rate={args.rate}"
+    if args.mode:
+        command += f" mode={args.mode}"
+    if args.log:
+        command += f" log={os.path.abspath(args.log)}"
+    if args.window:
+        command += f" window={args.window} warmup={args.warmup}"
+    reply = control(command)
+    if not reply.startswith("ok session="):
+        raise SystemExit(reply)
+    return int(reply.split("=", 1)[1])
+
+def trace_addresses(path):
+    # every address that transmits or receives in the trace
+    addresses = set()
+    with open(path, "r", encoding="utf-8") as f:
+        reader = csv.reader(f)
+        header = next(reader)
+        if "rx_num" in header:
+            # a sparse trace lists only the receivers of each line, so every line has to be read
+            src, first_rx = header.index("src_addr"), header.index("rx_num") + 1
+            for row in reader:
+                addresses.update(int(a) for a in [row[src]] + row[first_rx::2] if a not in ("", "0"))
+            return sorted(addresses)
+        columns = [i for i, name in enumerate(header) if name == "src_addr" or name.endswith("_addr")]
+        drone_num = sum(1 for name in header if name.endswith("_addr"))
+        for row in reader:
+            addresses.update(int(row[i]) for i in columns if i < len(row) and row[i] not in ("", "0"))
+            if len(addresses) >= drone_num:
+                break
+    return sorted(addresses)
+
+def run_session(args):
+    session_id = create_session(args)
+    addresses = [str(a) for a in trace_addresses(args.trace)]
+    print(f"session {session_id}: {len(addresses)} drones")
+
+    drones = []
+    for i in range(0, len(addresses), args.per_process):
+        command = [args.drone, "--session", str(session_id)] + addresses[i:i + args.per_process]
+        drones.append(subprocess.Popen(command, cwd=args.cwd, stdout=subprocess.DEVNULL))
+    failed = sum(1 for drone in drones if drone.wait() != 0)
+    print(f"session {session_id}: {len(drones)} drone processes finished, {failed} failed")
+    return 1 if failed else 0
+
+def join(session_id, address, mode, ranging_size):
+    # a join as a drone sends it; the drone stays in the session while the connection is open
+    s = socket.create_connection((center_ip, center_port))
+    return s, request(s, f"join session={session_id} mode={mode} ranging_size={ranging_size} addresses={address}")
+
+def check_rejoin(args):
+    # a drone that leaves a joining session frees its address, and once all have left the session takes
+    # any mode and message layout again; the check leaves an empty joining session behind
+    reply = control(f"create trace={os.path.abspath(args.trace)} nodes=2")
+    if not reply.startswith("ok session="):
+        raise SystemExit(reply)
+    session_id = int(reply.split("=", 1)[1])
+
+    first, reply = join(session_id, 1, "CHECK_A", 100)
+    first.close()
+    if not reply.startswith("ok"):
+        raise SystemExit(f"first join: {reply}")
+    for _ in range(50):
+        if f"\n{session_id} joining 0/2 " in control("list"):
+            break
+        time.sleep(0.1)
+    else:
+        raise SystemExit(f"session {session_id} still counts the departed drone")
+
+    again, reply = join(session_id, 1, "CHECK_B", 200)
+    duplicate, duplicate_reply = join(session_id, 1, "CHECK_B", 200)
+    again.close()
+    duplicate.close()
+    if not reply.startswith("ok"):
+        raise SystemExit(f"rejoin after disconnect: {reply}")
+    if not duplicate_reply.startswith("error"):
+        raise SystemExit(f"duplicate join accepted: {duplicate_reply}")
+    print(f"session {session_id}: rejoin after disconnect ok")
+    return 0
+
+def main():
+    parser = argparse.ArgumentParser(description="create, list and run sessions of a center started with -d")
+    parser.add_argument("command", choices=["create", "list", "run", "check"])
+    parser.add_argument("--trace", default=sys_path)
+    parser.add_argument("--nodes", type=int, default=0, help="drones of the session, default counts the trace")
+    parser.add_argument("--mode", default="", help="ranging mode the drones must be built with, e.g. CDSR")
+    parser.add_argument("--dilation", type=float, default=0)
+    parser.add_argument("--rate", type=int, default=1, help="RANGING_PERIOD_RATE of the session")
+    parser.add_argument("--log", default="", help="distance log of the drones, default is per session")
+    parser.add_argument("--window", default="", help="START:END system_time window to replay, default is the whole trace")
+    parser.add_argument("--warmup", type=int, default=2000, help="ms replayed before the window, marked [warmup] in the log")
+    parser.add_argument("--drone", default=drone_path)
+    parser.add_argument("--cwd", default="..", help="working directory of the drones")
+    parser.add_argument("--per-process", type=int, default=drones_per_process)
+    args = parser.parse_args()
+    args.drone = os.path.abspath(args.drone)
+
+    if args.command == "create":
+        print(create_session(args))
+    elif args.command == "list":
+        print(control("list"))
+    elif args.command == "check":
+        sys.exit(check_rejoin(args))
+    else:
+        sys.exit(run_session(args))
+
+if __name__ == "__main__":
+    main()
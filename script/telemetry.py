@@ -0,0 +1,142 @@
+import os
+import time
+import mmap
+import argparse
+import numpy as np
+
+# This script reads the shared-memory telemetry feed that drone and sim publish when built with TELEMETRY_ENABLE.
+# The layout is documented in telemetry.h; reading it is plain memory access, so a viewer never slows the
+# simulation down and a slow viewer only loses the samples that the ring has overwritten.
+
+
+telemetry_path = "/dev/shm/drone_simulation"
+local_address = 2
+neighbor_address = 3
+interval = 0.2                  # seconds between polls
+
+TELEMETRY_MAGIC = 0x4d4c5444
+TELEMETRY_VERSION = 1
+
+header_dtype = np.dtype([
+    ("magic", "<u4"), ("version", "<u2"), ("sampleSize", "<u2"), ("ringSize", "<u4"), ("linkMax", "<u4"),
+    ("head", "<u8"), ("initState", "<u4"), ("linkSize", "<u4"), ("reserved", "u1", 32),
+])
+link_dtype = np.dtype([
+    ("key", "<u4"), ("reserved", "<u4"), ("samples", "<u8"), ("truthSamples", "<u8"), ("lastDistance", "<f8"),
+    ("lastTruth", "<f8"), ("lastSystemTime", "<u8"), ("sumSquaredError", "<f8"), ("padding", "u1", 8),
+])
+sample_dtype = np.dtype([
+    ("seq", "<u8"), ("systemTime", "<u8"), ("timestamp", "<u8"), ("distance", "<f8"), ("truth", "<f8"),
+    ("local", "<u2"), ("neighbor", "<u2"), ("reserved", "<u4"),
+])
+
+
+class TelemetryFeed:
+    def __init__(self, path=telemetry_path, from_start=False):
+        with open(path, "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.header = np.frombuffer(self.map, header_dtype, 1, 0)
+        if self.header["magic"][0] != TELEMETRY_MAGIC or self.header["version"][0] != TELEMETRY_VERSION:
+            raise SystemExit(f"{path} is not a telemetry feed of version {TELEMETRY_VERSION}")
+
+        self.ring_size = int(self.header["ringSize"][0])
+        link_max = int(self.header["linkMax"][0])
+        self.links_view = np.frombuffer(self.map, link_dtype, link_max, header_dtype.itemsize)
+        self.ring = np.frombuffer(self.map, sample_dtype, self.ring_size, header_dtype.itemsize + link_max * link_dtype.itemsize)
+        self.next = 0 if from_start else int(self.header["head"][0])
+        self.dropped = 0
+
+    def poll(self):
+        # samples completed since the last poll; overwritten ones are counted in self.dropped
+        head = int(self.header["head"][0])
+        start = max(self.next, head - self.ring_size)
+        self.dropped += start - self.next
+        if start >= head:
+            self.next = start
+            return np.empty(0, sample_dtype)
+
+        n = np.arange(start, head, dtype=np.uint64)
+        index = n % self.ring_size
+        expected = 2 * n + 2
+        seq_before = self.ring["seq"][index]
+        samples = self.ring[index].copy()
+        seq_after = self.ring["seq"][index]
+
+        # stop at the first sample a producer is still writing and pick it up on the next poll
+        pending = np.nonzero(seq_before < expected)[0]
+        end = int(pending[0]) if pending.size else len(n)
+        valid = (seq_before[:end] == expected[:end]) & (seq_after[:end] == expected[:end])
+        self.dropped += int(end - np.count_nonzero(valid))
+        self.next = start + end
+        return samples[:end][valid]
+
+    def links(self):
+        links = self.links_view[self.links_view["key"] != 0].copy()
+        local = links["key"] >> 16
+        neighbor = links["key"] & 0xffff
+        return local, neighbor, links
+
+def print_links(feed):
+    local, neighbor, links = feed.links()
+    print(f"{'link':<14}{'samples':>10}{'truth':>10}{'last dist':>12}{'rmse':>10}")
+    for i in np.argsort(links["key"]):
+        rmse = np.sqrt(links["sumSquaredError"][i] / links["truthSamples"][i]) if links["truthSamples"][i] else np.nan
+        print(f"{f'{local[i]} <- {neighbor[i]}':<14}{links['samples'][i]:>10}{links['truthSamples'][i]:>10}{links['lastDistance'][i]:>12.2f}{rmse:>10.3f}")
+    print(f"head = {int(feed.header['head'][0])}, dropped by this viewer = {feed.dropped}")
+
+def plot_link(feed, local, neighbor, window):
+    import matplotlib.pyplot as plt
+
+    time_axis = np.empty(0)
+    distance = np.empty(0)
+    truth = np.empty(0)
+    plt.ion()
+    fig, ax = plt.subplots()
+    distance_line, = ax.plot([], [], label="distance")
+    truth_line, = ax.plot([], [], label="vicon")
+    ax.set_xlabel("system time (ms)")
+    ax.set_ylabel("distance")
+    ax.legend()
+
+    while plt.fignum_exists(fig.number):
+        samples = feed.poll()
+        samples = samples[(samples["local"] == local) & (samples["neighbor"] == neighbor)]
+        time_axis = np.concatenate([time_axis, samples["systemTime"]])[-window:]
+        distance = np.concatenate([distance, samples["distance"]])[-window:]
+        truth = np.concatenate([truth, samples["truth"]])[-window:]
+        if samples.size:
+            distance_line.set_data(time_axis, distance)
+            truth_line.set_data(time_axis, truth)
+            ax.relim()
+            ax.autoscale_view()
+            ax.set_title(f"local_{local} <- neighbor_{neighbor}, dropped {feed.dropped}")
+        plt.pause(interval)
+
+def main():
+    parser = argparse.ArgumentParser(description="live view of the shared-memory telemetry feed")
+    parser.add_argument("--path", default=telemetry_path)
+    parser.add_argument("--plot", action="store_true", help="plot local <- neighbor live")
+    parser.add_argument("--local", type=int, default=local_address)
+    parser.add_argument("--neighbor", type=int, default=neighbor_address)
+    parser.add_argument("--window", type=int, default=2000, help="samples kept on the plot")
+    parser.add_argument("--from-start", action="store_true", help="also read the samples still in the ring")
+    parser.add_argument("--unlink", action="store_true", help="remove the feed, the next run starts a fresh one")
+    args = parser.parse_args()
+
+    if args.unlink:
+        os.unlink(args.path)
+        return
+
+    feed = TelemetryFeed(args.path, args.from_start)
+    if args.plot:
+        plot_link(feed, args.local, args.neighbor, args.window)
+        return
+
+    while True:
+        samples = feed.poll()
+        print(f"{samples.size} new samples")
+        print_links(feed)
+        time.sleep(max(interval, 1.0))
+
+if __name__ == "__main__":
+    main()
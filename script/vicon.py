@@ -1,11 +1,16 @@
+import argparse
 import pandas as pd
 import motioncapture 
 import time
 import os
 import math
+from ground_truth import GroundTruthWriter
 
 
 # This script receives rigid body motion data in real-time from the host of the Vicon motion capture system via a network connection. 
+# Positions go to the binary store vicon.gt, O(N) per frame; pairwise distances to vicon.txt unless --no-text.
+
+WRITE_TEXT = True
 
 
 def calculate_distance(pos1, pos2):
@@ -16,6 +21,11 @@ def get_system_time():
 
 
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="record VICON rigid bodies")
+    parser.add_argument("--no-text", dest="text", action="store_false", default=WRITE_TEXT,
+                        help="skip the O(N^2) per frame vicon.txt, keep only vicon.gt")
+    args = parser.parse_args()
+
     df = pd.DataFrame(columns=[
         'rigid_body_name', 'time', 
         'position_x', 'position_y', 'position_z',
@@ -32,6 +42,7 @@ if __name__ == "__main__":
     
     output_dir = '../data'
     os.makedirs(output_dir, exist_ok=True)
+    store = None                # GroundTruthWriter of the monitored rigid bodies
 
     # Connect to Vicon host
     mc = motioncapture.connect("vicon", {"hostname": "172.20.10.2"})
@@ -68,6 +79,10 @@ if __name__ == "__main__":
                         target_rigids = sorted(detected_rigids)
                     
                     print(f"Final monitoring list: {target_rigids}")
+                    if all(name.isdigit() for name in target_rigids):
+                        store = GroundTruthWriter(os.path.join(output_dir, 'vicon.gt'), target_rigids)
+                    else:
+                        print("Warning: rigid body names are not drone addresses, vicon.gt is not written")
                     print("\nStarting formal data collection... (Press Ctrl+C to stop)")
             
             # 2. Formal processing phase: Only process filtered rigid bodies
@@ -91,7 +106,10 @@ if __name__ == "__main__":
                         for rigid in target_rigids
                     )
                     
-                    if all_updated:
+                    if all_updated and store is not None:
+                        store.add_frame(current_time, {int(rigid): rigid_cache[rigid]['position'] for rigid in target_rigids})
+
+                    if all_updated and args.text:
                         # Generate distance results in required format
                         for i in range(len(target_rigids)):
                             for j in range(i + 1, len(target_rigids)):
@@ -118,6 +136,9 @@ if __name__ == "__main__":
     except KeyboardInterrupt:
         print("\nUser interrupted collection, saving distance data...")
     finally:
+        if store is not None:
+            store.close()
+            print(f"\nPositions saved to: {os.path.join(output_dir, 'vicon.gt')}")
         if distance_lines:
             distance_file = os.path.join(output_dir, 'vicon.txt')
             with open(distance_file, 'w') as f:
@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include "replay.h"
+
+
+static FILE *distanceFile = NULL;
+
+
+/* same line layout as the drone log, plus the trace system time for alignment with vicon.txt */
+static void write_distance(Drone_Context_t *context, uint16_t neighborAddress, double distance, uint64_t timestamp, uint64_t systemTime) {
+    fprintf(distanceFile, "%s[local_%u <- neighbor_%u]: %s dist = %f, time = %lu, sys_time = %lu\n", context->warmup ? "[warmup] " : "", context->id, neighborAddress, RANGING_MODE, distance, timestamp, systemTime);
+}
+
+/* distance at a ground-truth instant, written with the truth so no alignment is needed afterwards */
+static void write_query(Drone_Context_t *context, const Trace_Query_t *query, double distance, uint64_t timestamp) {
+    fprintf(distanceFile, "%s[local_%u <- neighbor_%u]: %s dist = %f, time = %lu, sys_time = %lu, vicon = %f\n", context->warmup ? "[warmup] " : "", context->id, query->neighbor, RANGING_MODE, distance, timestamp, query->systemTime, query->truth);
+}
+
+static void usage() {
+    printf("Usage: ./sim [-t trace] [-o output] [-n lines] [-l packet_loss] [-c check_point] [-r ranging_period_rate] [-q vicon_file|vicon.gt [-w leftbound:rightbound]] [-s link_stats.csv] [-R window_start:window_end [-u warmup_ms]] [-j workers]\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_name = FILE_NAME;
+    const char *output_name = LOG_FILE_NAME;
+    const char *query_name = NULL;
+    const char *link_stats_name = NULL;
+    uint64_t leftbound = 0, rightbound = 0;
+    uint64_t window_end = 0, warmup = REPLAY_WARMUP;
+    Replay_Config_t config = {
+        .lineLimit = 0,
+        .rangingPeriodRate = RANGING_PERIOD_RATE,
+        .windowStart = 0,
+        .workers = 1,
+        .output = &distanceFile
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:n:l:c:r:q:w:s:R:u:j:h")) != -1) {
+        switch (opt) {
+            case 't': trace_name = optarg; break;
+            case 'o': output_name = optarg; break;
+            case 'n': config.lineLimit = atoi(optarg); break;
+            case 'l': packetLoss = atof(optarg); break;
+            case 'c': checkPoint = atoi(optarg); break;
+            case 'r': config.rangingPeriodRate = atoi(optarg); break;
+            case 'q': query_name = optarg; break;
+            case 's': link_stats_name = optarg; break;
+            case 'u': warmup = strtoull(optarg, NULL, 10); break;
+            case 'j': config.workers = atoi(optarg); break;
+            case 'R':
+                if (sscanf(optarg, "%lu:%lu", &config.windowStart, &window_end) != 2) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'w':
+                if (sscanf(optarg, "%lu:%lu", &leftbound, &rightbound) != 2) {
+                    usage();
+                    return 1;
+                }
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // checkPoint starts at CHECK_POINT as in the drones, so 0 samples nothing here either
+    if (checkPoint <= 0 && query_name == NULL) {
+        printf("Warning: CHECK_POINT is 0 and no -q is given, no distance is sampled; pass -c <check_point>\n");
+    }
+
+    // a replay window loads only its warm-up and itself, seeking through the offset index of the trace
+    Trace_t trace;
+    uint64_t replay_start = config.windowStart > warmup ? config.windowStart - warmup : 0;
+    if (trace_load_window(&trace, trace_name, replay_start, window_end) <= 0) {
+        printf("Failed to load %s\n", trace_name);
+        return 1;
+    }
+
+    // -q takes vicon.txt or the binary store written by script/ground_truth.py
+    Trace_Schedule_t schedule;
+    Gt_Store_t store;
+    if (query_name != NULL && gt_probe(query_name)) {
+        if (gt_open(&store, query_name, leftbound, rightbound) < 0) {
+            trace_free(&trace);
+            return 1;
+        }
+        groundTruth = &store;
+        querySink = write_query;
+    }
+    else if (query_name != NULL) {
+        if (schedule_load(&schedule, query_name, leftbound, rightbound) < 0) {
+            trace_free(&trace);
+            return 1;
+        }
+        querySchedule = &schedule;
+        querySink = write_query;
+    }
+
+    distanceFile = fopen(output_name, "w");
+    if (distanceFile == NULL) {
+        perror("Failed to open output file");
+        trace_free(&trace);
+        return 1;
+    }
+    nodeTrace = &trace;
+    distanceSink = write_distance;
+
+    #ifdef TELEMETRY_ENABLE
+        telemetry_open(TELEMETRY_NAME);
+    #endif
+
+    Replay_Swarm_t swarm;
+    replay_swarm_init(&swarm, &trace);
+    if (link_stats_name != NULL) {
+        link_stats_open(link_stats_name, swarm.context, swarm.count, LINK_STATS_PERIOD * 1000000ULL);
+    }
+    int replayed = replay_run(&swarm, &trace, &config);
+    if (replayed >= 0) {
+        printf("Replayed %d lines of %s with %d drones\n", replayed, trace_name, swarm.count);
+    }
+
+    link_stats_close();
+    replay_swarm_free(&swarm);
+    fclose(distanceFile);
+    if (querySchedule != NULL) {
+        schedule_free(&schedule);
+    }
+    if (groundTruth != NULL) {
+        gt_close(&store);
+    }
+    trace_free(&trace);
+    return replayed >= 0 ? 0 : 1;
+}
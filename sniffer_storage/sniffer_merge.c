@@ -0,0 +1,392 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define     MERGE_PROBE_ROWS        65536       // rows per capture searched for packets heard by two sniffers
+#define     MERGE_MIN_SHARED        16          // shared packets needed to trust an offset estimate
+#define     MERGE_DEDUP_WINDOW      500         // ms of corrected time within which the same (src, seq) is one packet
+#define     MERGE_DEDUP_BUCKETS     65536       // buckets of recently written packets, power of two
+#define     MERGE_DEDUP_WAYS        4
+#define     MERGE_BUFFER_SIZE       (1 << 20)   // stdio buffer per capture and for the output
+
+
+/* one packet of a capture in the probe, key is src_addr << 16 | msg_seq */
+typedef struct {
+    uint32_t key;
+    int64_t time;
+} Merge_Probe_t;
+
+typedef struct {
+    const char *filename;
+    FILE *fp;
+    char *line;                         // current row, still to be merged
+    size_t lineSize;
+    ssize_t lineLength;
+    size_t rowStart;                    // offset of the row in line, after fields left by rejected packets
+    uint32_t key;
+    int64_t time;                       // system_time of the row on the clock of this sniffer
+    int64_t offset;                     // added to time to get the clock of the reference capture
+    bool resolved;                      // offset estimated
+    Merge_Probe_t *probe;               // sorted by key, then time
+    int probeCount;
+    uint64_t rows;
+    uint64_t duplicates;
+    uint64_t malformed;
+} Merge_Capture_t;
+
+typedef struct {
+    uint32_t key;
+    int64_t time;                       // corrected time the packet was written at
+} Merge_Seen_t;
+
+
+char *header = NULL;
+int headerColumns = 0;
+int64_t dedupWindow = MERGE_DEDUP_WINDOW;
+int probeRows = MERGE_PROBE_ROWS;
+Merge_Seen_t (*seen)[MERGE_DEDUP_WAYS] = NULL;
+
+
+static int count_columns(const char *line) {
+    int columns = 0;
+    for (const char *c = line; *c != '\0'; c++) {
+        columns += *c == ',';
+    }
+    return columns;
+}
+
+/*
+ * system_time, src_addr and msg_seq of a row with as many columns as the header, the rest is copied verbatim.
+ * sniffer_storage writes only "system_time," for a packet without MAGIC_MATCH, which prefixes the next row: such
+ * leading fields are skipped, start is where the row begins.
+ */
+static bool parse_row(const char *line, int64_t *time, uint32_t *key, size_t *start) {
+    int extra = count_columns(line) - headerColumns;
+    if (extra < 0) {
+        return false;
+    }
+    const char *row = line;
+    for (; extra > 0; extra--) {
+        row = strchr(row, ',') + 1;
+    }
+    *start = row - line;
+    line = row;
+    char *end;
+    errno = 0;
+    unsigned long long system_time = strtoull(line, &end, 10);
+    if (*end != ',' || errno != 0) {
+        return false;
+    }
+    unsigned long src_addr = strtoul(end + 1, &end, 10);
+    if (*end != ',' || src_addr > UINT16_MAX) {
+        return false;
+    }
+    unsigned long msg_seq = strtoul(end + 1, &end, 10);
+    if (*end != ',' || msg_seq > UINT16_MAX) {
+        return false;
+    }
+    *time = (int64_t)system_time;
+    *key = (uint32_t)(src_addr << 16 | msg_seq);
+    return true;
+}
+
+/* advance to the next well-formed row, false at the end of the capture */
+static bool capture_next(Merge_Capture_t *capture) {
+    while ((capture->lineLength = getline(&capture->line, &capture->lineSize, capture->fp)) > 0) {
+        if (parse_row(capture->line, &capture->time, &capture->key, &capture->rowStart)) {
+            capture->rows++;
+            return true;
+        }
+        capture->malformed++;
+    }
+    return false;
+}
+
+static int capture_open(Merge_Capture_t *capture, const char *filename) {
+    memset(capture, 0, sizeof(Merge_Capture_t));
+    capture->filename = filename;
+    capture->fp = fopen(filename, "r");
+    if (capture->fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+    setvbuf(capture->fp, NULL, _IOFBF, MERGE_BUFFER_SIZE);
+    posix_fadvise(fileno(capture->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // every sniffer must write the same columns (MESSAGE_TX_POOL_SIZE, LISTENED_DRONES), rows are merged verbatim
+    if (getline(&capture->line, &capture->lineSize, capture->fp) <= 0 || strncmp(capture->line, "system_time,", 12) != 0) {
+        fprintf(stderr, "%s has no sniffer header\n", filename);
+        return -1;
+    }
+    if (header == NULL) {
+        header = strdup(capture->line);
+        headerColumns = count_columns(header);
+    }
+    else if (strcmp(header, capture->line) != 0) {
+        fprintf(stderr, "%s was written with other columns than the first capture\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+static void capture_close(Merge_Capture_t *capture) {
+    if (capture->fp != NULL) {
+        fclose(capture->fp);
+    }
+    free(capture->line);
+    free(capture->probe);
+}
+
+static int compare_probe(const void *a, const void *b) {
+    const Merge_Probe_t *x = a, *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+static int compare_offset(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* the first rows of a capture, rewound afterwards so that the merge reads it from the start */
+static int capture_probe(Merge_Capture_t *capture) {
+    capture->probe = malloc(probeRows * sizeof(Merge_Probe_t));
+    long start = ftell(capture->fp);
+    uint64_t malformed = capture->malformed;
+    while (capture->probeCount < probeRows && capture_next(capture)) {
+        capture->probe[capture->probeCount++] = (Merge_Probe_t){ .key = capture->key, .time = capture->time };
+    }
+    qsort(capture->probe, capture->probeCount, sizeof(Merge_Probe_t), compare_probe);
+
+    capture->rows = 0;
+    capture->malformed = malformed;
+    if (fseek(capture->fp, start, SEEK_SET) != 0) {
+        perror(capture->filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * offset of capture from reference: the median of the time differences of packets both heard, robust to the USB
+ * latency of single packets. A (src, seq) seen more than once in a probe is matched by its first occurrence.
+ */
+static int estimate_offset(const Merge_Capture_t *reference, const Merge_Capture_t *capture, int64_t *offset) {
+    int64_t *delta = malloc(((capture->probeCount < reference->probeCount ? capture->probeCount : reference->probeCount) + 1) * sizeof(int64_t));
+    int shared = 0;
+    int i = 0, j = 0;
+    while (i < reference->probeCount && j < capture->probeCount) {
+        uint32_t a = reference->probe[i].key, b = capture->probe[j].key;
+        if (a == b) {
+            delta[shared++] = reference->probe[i].time - capture->probe[j].time;
+        }
+        if (a <= b) {
+            for (uint32_t key = a; i < reference->probeCount && reference->probe[i].key == key; i++);
+        }
+        if (b <= a) {
+            for (uint32_t key = b; j < capture->probeCount && capture->probe[j].key == key; j++);
+        }
+    }
+    if (shared >= MERGE_MIN_SHARED) {
+        qsort(delta, shared, sizeof(int64_t), compare_offset);
+        *offset = reference->offset + delta[shared / 2];
+    }
+    free(delta);
+    return shared;
+}
+
+/* the first capture is the reference clock, every other one is resolved through a capture already resolved */
+static int estimate_offsets(Merge_Capture_t *capture, int count) {
+    capture[0].resolved = true;
+    for (bool progress = true; progress; ) {
+        progress = false;
+        for (int k = 1; k < count; k++) {
+            for (int r = 0; r < count && !capture[k].resolved; r++) {
+                if (!capture[r].resolved) {
+                    continue;
+                }
+                int shared = estimate_offset(&capture[r], &capture[k], &capture[k].offset);
+                if (shared >= MERGE_MIN_SHARED) {
+                    capture[k].resolved = true;
+                    progress = true;
+                    printf("%s: offset %ld ms from %d packets shared with %s\n", capture[k].filename, capture[k].offset, shared, capture[r].filename);
+                }
+            }
+        }
+    }
+
+    for (int k = 1; k < count; k++) {
+        if (!capture[k].resolved) {
+            fprintf(stderr, "%s shares fewer than %d packets with the other captures in its first %d rows, its clock offset is unknown\n", capture[k].filename, MERGE_MIN_SHARED, probeRows);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* heap of captures ordered by corrected time of their current row, ties by capture so that merges are repeatable */
+static bool heap_less(const Merge_Capture_t *capture, int a, int b) {
+    int64_t x = capture[a].time + capture[a].offset, y = capture[b].time + capture[b].offset;
+    return x < y || (x == y && a < b);
+}
+
+static void heap_down(int *heap, int size, const Merge_Capture_t *capture, int i) {
+    for (;;) {
+        int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && heap_less(capture, heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < size && heap_less(capture, heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        int swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/*
+ * a packet heard by several sniffers is written once: the rows of one packet are within dedupWindow after offset
+ * correction. Entries older than the window are free, so memory is bounded by the packets of one window; a bucket
+ * holding MERGE_DEDUP_WAYS live packets forgets the oldest of them.
+ */
+static bool seen_before(uint32_t key, int64_t time) {
+    uint32_t hash = key * 2654435761u;
+    Merge_Seen_t *bucket = seen[hash >> 16 & (MERGE_DEDUP_BUCKETS - 1)];
+    int oldest = 0;
+    for (int i = 0; i < MERGE_DEDUP_WAYS; i++) {
+        if (bucket[i].key == key && bucket[i].time != INT64_MIN && time - bucket[i].time <= dedupWindow) {
+            return true;
+        }
+        if (bucket[i].time < bucket[oldest].time) {
+            oldest = i;
+        }
+    }
+    bucket[oldest].key = key;
+    bucket[oldest].time = time;
+    return false;
+}
+
+static void usage() {
+    printf("Usage: ./sniffer_merge [-o merged.csv] [-w dedup_window_ms] [-p probe_rows] capture.csv capture.csv ...\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_name = "../data/raw_sensor_data.csv";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:w:p:h")) != -1) {
+        switch (opt) {
+            case 'o': output_name = optarg; break;
+            case 'w': dedupWindow = atoll(optarg); break;
+            case 'p': probeRows = atoi(optarg); break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    int count = argc - optind;
+    if (count < 1 || probeRows < MERGE_MIN_SHARED || dedupWindow < 0) {
+        usage();
+        return 1;
+    }
+
+    Merge_Capture_t *capture = calloc(count, sizeof(Merge_Capture_t));
+    int result = 0;
+    for (int k = 0; k < count && result == 0; k++) {
+        if (capture_open(&capture[k], argv[optind + k]) < 0 || capture_probe(&capture[k]) < 0) {
+            result = -1;
+        }
+    }
+    if (result == 0 && estimate_offsets(capture, count) < 0) {
+        result = -1;
+    }
+
+    FILE *output = NULL;
+    if (result == 0) {
+        output = fopen(output_name, "w");
+        if (output == NULL) {
+            perror("Failed to open output file");
+            result = -1;
+        }
+    }
+    if (result < 0) {
+        for (int k = 0; k < count; k++) {
+            capture_close(&capture[k]);
+        }
+        free(capture);
+        return 1;
+    }
+    setvbuf(output, NULL, _IOFBF, MERGE_BUFFER_SIZE);
+    fputs(header, output);
+
+    seen = malloc(MERGE_DEDUP_BUCKETS * sizeof(*seen));
+    for (int i = 0; i < MERGE_DEDUP_BUCKETS; i++) {
+        for (int j = 0; j < MERGE_DEDUP_WAYS; j++) {
+            seen[i][j] = (Merge_Seen_t){ .key = 0, .time = INT64_MIN };
+        }
+    }
+
+    // k-way merge on corrected time, one row per capture in memory
+    int *heap = malloc(count * sizeof(int));
+    int size = 0;
+    for (int k = 0; k < count; k++) {
+        free(capture[k].probe);
+        capture[k].probe = NULL;
+        if (capture_next(&capture[k])) {
+            heap[size++] = k;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) {
+        heap_down(heap, size, capture, i);
+    }
+
+    uint64_t merged = 0;
+    while (size > 0) {
+        Merge_Capture_t *next = &capture[heap[0]];
+        int64_t time = next->time + next->offset;
+        if (seen_before(next->key, time)) {
+            next->duplicates++;
+        }
+        else {
+            // system_time is rewritten on the reference clock, the rest of the row is unchanged
+            const char *rest = strchr(next->line + next->rowStart, ',');
+            fprintf(output, "%ld", time);
+            fwrite(rest, 1, next->lineLength - (rest - next->line), output);
+            merged++;
+        }
+
+        if (!capture_next(next)) {
+            heap[0] = heap[--size];
+        }
+        heap_down(heap, size, capture, 0);
+    }
+
+    if (fclose(output) != 0) {
+        perror("Failed to write output file");
+        result = -1;
+    }
+    for (int k = 0; k < count; k++) {
+        printf("%s: %lu rows, %lu duplicates, %lu malformed\n", capture[k].filename, capture[k].rows, capture[k].duplicates, capture[k].malformed);
+        capture_close(&capture[k]);
+    }
+    printf("Merged %lu packets into %s\n", merged, output_name);
+
+    free(heap);
+    free(seen);
+    free(capture);
+    free(header);
+    return result < 0 ? 1 : 0;
+}
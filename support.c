@@ -1,3 +1,4 @@
+#include <time.h>
 #include "support.h"
 
 
@@ -8,6 +9,8 @@ dwTime_t lastRxTimestamp;
 dwTime_t TxTimestamp;                                   
 dwTime_t RxTimestamp;                                   
 
+const char *logFileName = LOG_FILE_NAME;
+
 
 /* DEBUG_PRINT */
 void DEBUG_PRINT(const char *format, ...) {
@@ -20,17 +23,7 @@ void DEBUG_PRINT(const char *format, ...) {
     va_end(args);
 
     // print to file
-    #if defined(IEEE_802_15_4Z)
-    FILE *log_file = first_call ? fopen("./data/log/ieee.txt", "w") : fopen("./data/log/ieee.txt", "a");
-    #elif defined(SWARM_RANGING_V1)
-    FILE *log_file = first_call ? fopen("./data/log/swarm_v1.txt", "w") : fopen("./data/log/swarm_v1.txt", "a");
-    #elif defined(SWARM_RANGING_V2)
-    FILE *log_file = first_call ? fopen("./data/log/swarm_v2.txt", "w") : fopen("./data/log/swarm_v2.txt", "a");
-    #elif defined(DYNAMIC_RANGING)
-    FILE *log_file = first_call ? fopen("./data/log/dynamic.txt", "w") : fopen("./data/log/dynamic.txt", "a");
-    #elif defined(COMPENSATE_DYNAMIC_RANGING)
-    FILE *log_file = first_call ? fopen("./data/log/compensate.txt", "w") : fopen("./data/log/compensate.txt", "a");
-    #endif
+    FILE *log_file = first_call ? fopen(logFileName, "w") : fopen(logFileName, "a");
 
     if (log_file != NULL) {
         va_start(args, format);  
@@ -40,7 +33,7 @@ void DEBUG_PRINT(const char *format, ...) {
         first_call = false;
     } 
     else {
-        printf("Warning: Could not open modified_Log.txt for writing\n");
+        printf("Warning: Could not open %s for writing\n", logFileName);
     }
 }
 
@@ -101,4 +94,11 @@ TickType_t xTaskGetTickCount() {
         RxTimestamp.full = 0;
     }
     return curTicks;
+}
+
+/* CLOCK_MONOTONIC */
+uint64_t get_monotonic_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
\ No newline at end of file
@@ -21,11 +21,15 @@
 #define COMPENSATE_DYNAMIC_RANGING
 
 // #define REAL_TIME_ENABLE
+// #define TELEMETRY_ENABLE
 
 #define     CHECK_POINT             0       // number of nodes queried for distance between two received messages
 #define     NODES_NUM               2       // the total number of drones in the system
 #define     PACKET_LOSS             0       // packet loss rate for simulating communication link quality
 #define     RANGING_PERIOD_RATE     1       // rate multiplier for ranging data transmission period
+#define     TIME_DILATION           0       // stretch of recorded system_time spacing for paced replay (0.1 - 100), 0 replays unpaced
+#define     LINK_STATS_PERIOD       0       // ms between snapshots of the per-link counters, 0 disables them
+#define     REPLAY_WARMUP           2000    // ms of trace replayed before a replay window, outputs marked [warmup]
 
 #if defined(IEEE_802_15_4Z) || defined(SWARM_RANGING_V1) || defined(SWARM_RANGING_V2)
 #define CLASSIC_RANGING_MODE
@@ -33,6 +37,29 @@
 #define MODIFIED_RANGING_MODE
 #endif
 
+#if defined(IEEE_802_15_4Z)
+#define     RANGING_MODE            "IEEE"
+#define     LOG_FILE_NAME           "./data/log/ieee.txt"
+#elif defined(SWARM_RANGING_V1)
+#define     RANGING_MODE            "SR_V1"
+#define     LOG_FILE_NAME           "./data/log/swarm_v1.txt"
+#elif defined(SWARM_RANGING_V2)
+#define     RANGING_MODE            "SR_V2"
+#define     LOG_FILE_NAME           "./data/log/swarm_v2.txt"
+#elif defined(DYNAMIC_RANGING)
+#define     RANGING_MODE            "DSR"
+#define     LOG_FILE_NAME           "./data/log/dynamic.txt"
+#elif defined(COMPENSATE_DYNAMIC_RANGING)
+#define     RANGING_MODE            "CDSR"
+#define     LOG_FILE_NAME           "./data/log/compensate.txt"
+#endif
+
+#define     TELEMETRY_NAME          "/drone_simulation"     // shared-memory feed of TELEMETRY_ENABLE, /dev/shm/drone_simulation
+#define     TELEMETRY_RING_SIZE     65536   // distance samples kept in the feed, power of two
+#define     TELEMETRY_LINK_MAX      4096    // (local, neighbor) links with counters in the feed
+#define     REPLAY_SHARD_RING       1024    // Tx messages in flight between the shards of sim -j, power of two
+#define     LAUNCH_NAME             "/drone_launch"         // shared-memory control block and trace image of launch, suffixed with its pid
+
 
 typedef         uint16_t                    UWB_Address_t;
 typedef         uint32_t                    TickType_t;
@@ -91,6 +118,7 @@ typedef struct {
 
 
 /* DEBUG_PRINT */
+extern const char *logFileName;         // LOG_FILE_NAME unless a session names its own log
 void DEBUG_PRINT(const char *format, ...);
 
 /* SemaphoreHandle_t */
@@ -101,4 +129,7 @@ int xSemaphoreGive(SemaphoreHandle_t mutex);
 
 /* TimerHandle_t */
 TickType_t xTaskGetTickCount();
+
+/* CLOCK_MONOTONIC in ns, shared by center and drones on one host for paced replay */
+uint64_t get_monotonic_time();
 #endif
\ No newline at end of file
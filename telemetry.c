@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "telemetry.h"
+
+
+_Static_assert(sizeof(Telemetry_Header_t) == 64, "Telemetry_Header_t layout");
+_Static_assert(sizeof(Telemetry_Link_t) == 64, "Telemetry_Link_t layout");
+_Static_assert(sizeof(Telemetry_Sample_t) == 48, "Telemetry_Sample_t layout");
+_Static_assert((TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) == 0, "TELEMETRY_RING_SIZE must be a power of two");
+
+static Telemetry_Header_t *telemetryHeader = NULL;
+static Telemetry_Link_t *telemetryLink = NULL;
+static Telemetry_Sample_t *telemetryRing = NULL;
+static size_t telemetrySize = 0;
+
+
+/* map the feed, creating it if this is the first producer; the feed outlives the run for late viewers */
+int telemetry_open(const char *name) {
+    telemetrySize = sizeof(Telemetry_Header_t) + TELEMETRY_LINK_MAX * sizeof(Telemetry_Link_t) + TELEMETRY_RING_SIZE * sizeof(Telemetry_Sample_t);
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open telemetry failed");
+        return -1;
+    }
+    // every producer sizes the segment the same way, a fresh segment reads as zero
+    if (ftruncate(fd, telemetrySize) < 0) {
+        perror("ftruncate telemetry failed");
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, telemetrySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap telemetry failed");
+        return -1;
+    }
+
+    telemetryHeader = base;
+    telemetryLink = (Telemetry_Link_t*)(telemetryHeader + 1);
+    telemetryRing = (Telemetry_Sample_t*)(telemetryLink + TELEMETRY_LINK_MAX);
+
+    uint32_t state = 0;
+    if (atomic_compare_exchange_strong(&telemetryHeader->initState, &state, 1)) {
+        telemetryHeader->version = TELEMETRY_VERSION;
+        telemetryHeader->sampleSize = sizeof(Telemetry_Sample_t);
+        telemetryHeader->ringSize = TELEMETRY_RING_SIZE;
+        telemetryHeader->linkMax = TELEMETRY_LINK_MAX;
+        telemetryHeader->linkSize = sizeof(Telemetry_Link_t);
+        telemetryHeader->magic = TELEMETRY_MAGIC;
+        atomic_store(&telemetryHeader->initState, 2);
+    }
+    while (atomic_load(&telemetryHeader->initState) != 2) {
+        sched_yield();
+    }
+
+    if (telemetryHeader->version != TELEMETRY_VERSION || telemetryHeader->ringSize != TELEMETRY_RING_SIZE || telemetryHeader->linkMax != TELEMETRY_LINK_MAX) {
+        fprintf(stderr, "Telemetry segment %s has another layout, remove /dev/shm%s\n", name, name);
+        telemetry_close();
+        return -1;
+    }
+    return 0;
+}
+
+void telemetry_close() {
+    if (telemetryHeader != NULL) {
+        munmap(telemetryHeader, telemetrySize);
+        telemetryHeader = NULL;
+        telemetryLink = NULL;
+        telemetryRing = NULL;
+    }
+}
+
+/* open addressing on the link key, entries are claimed once and never freed */
+static Telemetry_Link_t *telemetry_link(uint16_t local, uint16_t neighbor) {
+    uint32_t key = (uint32_t)local << 16 | neighbor;
+    if (key == 0) {
+        return NULL;
+    }
+
+    uint32_t index = (key * 2654435761u) % TELEMETRY_LINK_MAX;
+    for (int probe = 0; probe < TELEMETRY_LINK_MAX; probe++) {
+        Telemetry_Link_t *link = &telemetryLink[(index + probe) % TELEMETRY_LINK_MAX];
+        uint32_t current = atomic_load_explicit(&link->key, memory_order_acquire);
+        if (current == key) {
+            return link;
+        }
+        if (current == 0) {
+            uint32_t expected = 0;
+            if (atomic_compare_exchange_strong(&link->key, &expected, key) || expected == key) {
+                return link;
+            }
+        }
+    }
+    return NULL;
+}
+
+void telemetry_publish(uint16_t local, uint16_t neighbor, double distance, double truth, uint64_t timestamp, uint64_t systemTime) {
+    if (telemetryHeader == NULL) {
+        return;
+    }
+
+    uint64_t n = atomic_fetch_add_explicit(&telemetryHeader->head, 1, memory_order_relaxed);
+    Telemetry_Sample_t *sample = &telemetryRing[n & (TELEMETRY_RING_SIZE - 1)];
+
+    atomic_store_explicit(&sample->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    sample->systemTime = systemTime;
+    sample->timestamp = timestamp;
+    sample->distance = distance;
+    sample->truth = truth;
+    sample->local = local;
+    sample->neighbor = neighbor;
+    atomic_store_explicit(&sample->seq, 2 * n + 2, memory_order_release);
+
+    Telemetry_Link_t *link = telemetry_link(local, neighbor);
+    if (link != NULL) {
+        link->lastDistance = distance;
+        link->lastTruth = truth;
+        link->lastSystemTime = systemTime;
+        if (!isnan(truth)) {
+            link->sumSquaredError += (distance - truth) * (distance - truth);
+            atomic_fetch_add_explicit(&link->truthSamples, 1, memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&link->samples, 1, memory_order_release);
+    }
+}
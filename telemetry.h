@@ -0,0 +1,64 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+
+#include <stdatomic.h>
+#include "support.h"
+
+
+/*
+ * Shared-memory telemetry feed, /dev/shm/<TELEMETRY_NAME without '/'>, little-endian:
+ *
+ *   offset 0                       Telemetry_Header_t      (64 bytes)
+ *   offset 64                      Telemetry_Link_t        [TELEMETRY_LINK_MAX]     (64 bytes each)
+ *   offset 64 + 64 * LINK_MAX      Telemetry_Sample_t      [TELEMETRY_RING_SIZE]    (48 bytes each)
+ *
+ * Producers claim sample number n with a fetch-add on `head` and write slot n % TELEMETRY_RING_SIZE as a
+ * seqlock: `seq` is 2n + 1 while the slot is written and 2n + 2 once it is complete. A reader of sample n
+ * accepts the slot only if `seq` reads 2n + 2 before and after copying it, so a reader that falls more
+ * than TELEMETRY_RING_SIZE samples behind loses samples but never blocks a producer.
+ */
+
+#define     TELEMETRY_MAGIC         0x4d4c5444      // "DTLM"
+#define     TELEMETRY_VERSION       1
+
+typedef struct {
+    uint32_t magic;                                 // written last by the process that initializes the segment
+    uint16_t version;
+    uint16_t sampleSize;
+    uint32_t ringSize;                              // power of two
+    uint32_t linkMax;
+    _Atomic uint64_t head;                          // number of samples claimed so far
+    _Atomic uint32_t initState;                     // 0 fresh, 1 initializing, 2 ready
+    uint32_t linkSize;
+    uint8_t reserved[32];
+} Telemetry_Header_t;
+
+typedef struct {
+    _Atomic uint32_t key;                           // local << 16 | neighbor, 0 while the entry is free
+    uint32_t reserved;
+    _Atomic uint64_t samples;                       // distances published on the link
+    _Atomic uint64_t truthSamples;                  // ... of which carried a ground-truth distance
+    double lastDistance;
+    double lastTruth;                               // NaN without ground truth
+    uint64_t lastSystemTime;
+    double sumSquaredError;                         // over the samples with ground truth
+    uint8_t padding[8];
+} Telemetry_Link_t;                                 // written only by the process hosting `local`
+
+typedef struct {
+    _Atomic uint64_t seq;
+    uint64_t systemTime;                            // trace system time (ms), 0 if unknown
+    uint64_t timestamp;                             // receiver's 40-bit UWB time of the estimate
+    double distance;
+    double truth;                                   // NaN without ground truth
+    uint16_t local;
+    uint16_t neighbor;
+    uint32_t reserved;
+} Telemetry_Sample_t;
+
+
+int telemetry_open(const char *name);
+void telemetry_close();
+void telemetry_publish(uint16_t local, uint16_t neighbor, double distance, double truth, uint64_t timestamp, uint64_t systemTime);
+#endif
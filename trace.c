@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "trace.h"
+#include "archive.h"
+
+
+_Static_assert(sizeof(Trace_Image_Header_t) == 64, "Trace_Image_Header_t layout");
+
+
+int trace_count_rx(const char *header) {
+    int rx_count = 0;
+    char *copy = strdup(header);
+    char *token = strtok(copy, ",");
+
+    while (token != NULL) {
+        if (strncmp(token, "Rx", 2) == 0 && strstr(token, "_addr")) {
+            rx_count++;
+        }
+        token = strtok(NULL, ",");
+    }
+
+    free(copy);
+    return rx_count;
+}
+
+/* a sparse trace lists only the receivers of each line after an rx_num column */
+bool trace_is_sparse(const char *header) {
+    bool sparse = false;
+    char *copy = strdup(header);
+    char *token = strtok(copy, ",\r\n");
+
+    while (token != NULL) {
+        if (strcmp(token, "rx_num") == 0) {
+            sparse = true;
+        }
+        token = strtok(NULL, ",\r\n");
+    }
+
+    free(copy);
+    return sparse;
+}
+
+/* system_time,src_addr,msg_seq,filter,Tx_time,[rx_num,]Rx0_addr,Rx0_time,... -> number of receivers, -1 if malformed */
+int trace_parse_line(const char *text, Trace_Line_t *line, Trace_Rx_t *rx, int maxRx, bool sparse) {
+    char *end;
+
+    line->systemTime = strtoull(text, &end, 10);
+    if (end == text || *end != ',') {
+        return -1;
+    }
+    line->srcAddress = (uint16_t)strtoul(end + 1, &end, 10);
+    line->msgSeq = (uint16_t)strtoul(end + 1, &end, 10);
+    line->filter = (uint16_t)strtoul(end + 1, &end, 10);
+    line->txTimestamp.full = strtoull(end + 1, &end, 10);
+    if (sparse) {
+        if (*end != ',') {
+            return -1;
+        }
+        unsigned long rx_num = strtoul(end + 1, &end, 10);
+        if (rx_num < (unsigned long)maxRx) {
+            maxRx = (int)rx_num;
+        }
+    }
+
+    int count = 0;
+    while (*end == ',' && count < maxRx) {
+        char *field = end + 1;
+        rx[count].address = (uint16_t)strtoul(field, &end, 10);
+        if (end == field || *end != ',') {
+            break;
+        }
+        rx[count].timestamp.full = strtoull(end + 1, &end, 10);
+        count++;
+    }
+    line->rxCount = count;
+    return count;
+}
+
+/* offsets of every TRACE_INDEX_STRIDE-th line, -1 if the trace cannot be read */
+static int64_t trace_index_build(const char *filename, Trace_Index_Entry_t **entry) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Failed to open trace");
+        return -1;
+    }
+
+    int64_t count = 0, capacity = 1024;
+    *entry = malloc(capacity * sizeof(Trace_Index_Entry_t));
+    char *text = NULL;
+    size_t text_size = 0;
+    if (getline(&text, &text_size, fp) > 0) {
+        uint64_t line = 0;
+        long offset = ftell(fp);
+        while (getline(&text, &text_size, fp) > 0 && *text != '\n' && *text != '\r') {
+            if (line % TRACE_INDEX_STRIDE == 0) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    *entry = realloc(*entry, capacity * sizeof(Trace_Index_Entry_t));
+                }
+                (*entry)[count++] = (Trace_Index_Entry_t){
+                    .systemTime = strtoull(text, NULL, 10),
+                    .offset = (uint64_t)offset,
+                    .line = line
+                };
+            }
+            line++;
+            offset = ftell(fp);
+        }
+    }
+
+    free(text);
+    fclose(fp);
+    return count;
+}
+
+/* the index <filename>.idx, rebuilt when the trace changed since it was written */
+static int64_t trace_index_load(const char *filename, Trace_Index_Entry_t **entry) {
+    struct stat st;
+    if (stat(filename, &st) < 0) {
+        perror("Failed to stat trace");
+        return -1;
+    }
+    Trace_Index_Header_t header = {
+        .magic = TRACE_INDEX_MAGIC,
+        .stride = TRACE_INDEX_STRIDE,
+        .traceSize = (uint64_t)st.st_size,
+        .traceMtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec
+    };
+
+    char index_name[strlen(filename) + sizeof(".idx")];
+    snprintf(index_name, sizeof(index_name), "%s.idx", filename);
+    FILE *fp = fopen(index_name, "rb");
+    if (fp) {
+        Trace_Index_Header_t stored;
+        if (fread(&stored, sizeof(stored), 1, fp) == 1 && memcmp(stored.magic, header.magic, 4) == 0 && stored.stride == header.stride
+            && stored.traceSize == header.traceSize && stored.traceMtime == header.traceMtime) {
+            *entry = malloc((stored.entryCount > 0 ? stored.entryCount : 1) * sizeof(Trace_Index_Entry_t));
+            if (fread(*entry, sizeof(Trace_Index_Entry_t), stored.entryCount, fp) == stored.entryCount) {
+                fclose(fp);
+                return (int64_t)stored.entryCount;
+            }
+            free(*entry);
+        }
+        fclose(fp);
+    }
+
+    int64_t count = trace_index_build(filename, entry);
+    if (count < 0) {
+        return -1;
+    }
+    header.entryCount = (uint64_t)count;
+
+    // an index that cannot be written is only rebuilt next time
+    fp = fopen(index_name, "wb");
+    if (fp) {
+        fwrite(&header, sizeof(header), 1, fp);
+        fwrite(*entry, sizeof(Trace_Index_Entry_t), count, fp);
+        fclose(fp);
+    }
+    return count;
+}
+
+/* a trace or a query schedule, plain text or an archive of it */
+FILE *trace_fopen(const char *filename) {
+    return archive_probe(filename) ? archive_fopen(filename) : fopen(filename, "r");
+}
+
+/* the block index of an archive stands in for <filename>.idx */
+static int trace_seek_archive(FILE *fp, const char *filename, uint64_t systemTime, uint64_t *line) {
+    Archive_Reader_t reader;
+    if (archive_open(&reader, filename) < 0) {
+        return -1;
+    }
+    int result = 0;
+    int block = archive_lower_bound(&reader, systemTime);
+    if (block > 0) {
+        uint64_t first_line = block < reader.blockCount ? reader.block[block].firstLine : reader.block[block - 1].firstLine + reader.block[block - 1].lineCount;
+        uint64_t offset = block < reader.blockCount ? reader.block[block].textOffset : reader.block[block - 1].textOffset + reader.block[block - 1].textLength;
+        *line = first_line - 1;
+        result = fseek(fp, (long)offset, SEEK_SET);
+    }
+    archive_close(&reader);
+    return result;
+}
+
+/* moves fp to the last indexed line before systemTime, *line is the number of lines before it */
+int trace_seek(FILE *fp, const char *filename, uint64_t systemTime, uint64_t *line) {
+    if (archive_probe(filename)) {
+        return trace_seek_archive(fp, filename, systemTime, line);
+    }
+
+    Trace_Index_Entry_t *entry;
+    int64_t count = trace_index_load(filename, &entry);
+    if (count < 0) {
+        return -1;
+    }
+
+    int64_t lo = 0, hi = count;
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (entry[mid].systemTime < systemTime) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // lines sharing the system_time of an entry may precede it
+    int result = 0;
+    if (lo > 0) {
+        *line = entry[lo - 1].line;
+        result = fseek(fp, (long)entry[lo - 1].offset, SEEK_SET);
+    }
+    free(entry);
+    return result;
+}
+
+int trace_load(Trace_t *trace, const char *filename) {
+    return trace_load_window(trace, filename, 0, 0);
+}
+
+/* lines with system_time in [from, to], to 0 keeps the rest of the trace */
+int trace_load_window(Trace_t *trace, const char *filename, uint64_t from, uint64_t to) {
+    memset(trace, 0, sizeof(Trace_t));
+
+    FILE *fp = trace_fopen(filename);
+    if (!fp) {
+        perror("Failed to open trace");
+        return -1;
+    }
+
+    char *text = NULL;
+    size_t text_size = 0;
+    if (getline(&text, &text_size, fp) < 0) {
+        fprintf(stderr, "Empty trace %s\n", filename);
+        free(text);
+        fclose(fp);
+        return -1;
+    }
+    trace->sparse = trace_is_sparse(text);
+    trace->rxColumns = trace->sparse ? 0 : trace_count_rx(text);
+
+    uint64_t line_number = 0;
+    if (from > 0 && trace_seek(fp, filename, from, &line_number) < 0) {
+        free(text);
+        fclose(fp);
+        return -1;
+    }
+
+    int line_capacity = 1024;
+    int rx_capacity = 1024 * (trace->rxColumns > 0 ? trace->rxColumns : 1);
+    trace->line = malloc(line_capacity * sizeof(Trace_Line_t));
+    trace->rx = malloc(rx_capacity * sizeof(Trace_Rx_t));
+
+    ssize_t length;
+    for (; (length = getline(&text, &text_size, fp)) > 0; line_number++) {
+        if (*text == '\n' || *text == '\r') {
+            break;
+        }
+        uint64_t system_time = strtoull(text, NULL, 10);
+        if (system_time < from) {
+            continue;
+        }
+        if (to != 0 && system_time > to) {
+            break;
+        }
+        if (trace->lineCount == line_capacity) {
+            line_capacity *= 2;
+            trace->line = realloc(trace->line, line_capacity * sizeof(Trace_Line_t));
+        }
+        // every receiver of a sparse line takes at least four characters, "a,t,"
+        int max_rx = trace->sparse ? (int)(length / 4) + 1 : trace->rxColumns;
+        while (trace->rxTotal + max_rx > rx_capacity) {
+            rx_capacity *= 2;
+            trace->rx = realloc(trace->rx, rx_capacity * sizeof(Trace_Rx_t));
+        }
+
+        Trace_Line_t *line = &trace->line[trace->lineCount];
+        if (trace_parse_line(text, line, &trace->rx[trace->rxTotal], max_rx, trace->sparse) < 0) {
+            continue;
+        }
+        if (trace->lineCount == 0) {
+            trace->firstLine = (int)line_number;
+        }
+        line->rxIndex = trace->rxTotal;
+        trace->rxTotal += line->rxCount;
+        trace->lineCount++;
+    }
+
+    free(text);
+    fclose(fp);
+    return trace->lineCount;
+}
+
+void trace_free(Trace_t *trace) {
+    if (trace->image != NULL) {
+        munmap(trace->image, trace->imageSize);
+    }
+    else {
+        free(trace->line);
+        free(trace->rx);
+    }
+    memset(trace, 0, sizeof(Trace_t));
+}
+
+/* copies a loaded trace into the shared-memory segment `name`, so other processes attach it instead of parsing the file */
+int trace_share(const Trace_t *trace, const char *name) {
+    size_t line_bytes = (size_t)trace->lineCount * sizeof(Trace_Line_t);
+    size_t size = sizeof(Trace_Image_Header_t) + line_bytes + (size_t)trace->rxTotal * sizeof(Trace_Rx_t);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("shm_open trace image failed");
+        return -1;
+    }
+    if (ftruncate(fd, size) < 0) {
+        perror("ftruncate trace image failed");
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    uint8_t *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap trace image failed");
+        shm_unlink(name);
+        return -1;
+    }
+
+    Trace_Image_Header_t *header = (Trace_Image_Header_t *)base;
+    memcpy(base + sizeof(Trace_Image_Header_t), trace->line, line_bytes);
+    memcpy(base + sizeof(Trace_Image_Header_t) + line_bytes, trace->rx, (size_t)trace->rxTotal * sizeof(Trace_Rx_t));
+    *header = (Trace_Image_Header_t){
+        .headerSize = sizeof(Trace_Image_Header_t),
+        .lineSize = sizeof(Trace_Line_t),
+        .rxSize = sizeof(Trace_Rx_t),
+        .lineCount = trace->lineCount,
+        .rxTotal = trace->rxTotal,
+        .rxColumns = trace->rxColumns,
+        .firstLine = trace->firstLine,
+        .sparse = trace->sparse
+    };
+    memcpy(header->magic, TRACE_IMAGE_MAGIC, 4);
+    munmap(base, size);
+    return 0;
+}
+
+/* maps the image written by trace_share read-only, trace_free unmaps it */
+int trace_attach(Trace_t *trace, const char *name) {
+    memset(trace, 0, sizeof(Trace_t));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open trace image failed");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Trace_Image_Header_t)) {
+        fprintf(stderr, "Trace image %s is truncated\n", name);
+        close(fd);
+        return -1;
+    }
+    uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap trace image failed");
+        return -1;
+    }
+
+    const Trace_Image_Header_t *header = (const Trace_Image_Header_t *)base;
+    size_t line_bytes = (size_t)header->lineCount * sizeof(Trace_Line_t);
+    if (memcmp(header->magic, TRACE_IMAGE_MAGIC, 4) != 0 || header->headerSize != sizeof(Trace_Image_Header_t)
+        || header->lineSize != sizeof(Trace_Line_t) || header->rxSize != sizeof(Trace_Rx_t)
+        || (size_t)st.st_size != sizeof(Trace_Image_Header_t) + line_bytes + (size_t)header->rxTotal * sizeof(Trace_Rx_t)) {
+        fprintf(stderr, "Trace image %s has another layout\n", name);
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    trace->line = (Trace_Line_t *)(base + sizeof(Trace_Image_Header_t));
+    trace->rx = (Trace_Rx_t *)(base + sizeof(Trace_Image_Header_t) + line_bytes);
+    trace->lineCount = header->lineCount;
+    trace->rxTotal = header->rxTotal;
+    trace->rxColumns = header->rxColumns;
+    trace->firstLine = header->firstLine;
+    trace->sparse = header->sparse;
+    trace->image = base;
+    trace->imageSize = st.st_size;
+    return trace->lineCount;
+}
+
+/* first line at or after `from` in which `address` received at `timestamp`, -1 if none */
+int trace_find_rx(const Trace_t *trace, int from, uint16_t address, uint64_t timestamp) {
+    for (int i = from < 0 ? 0 : from; i < trace->lineCount; i++) {
+        const Trace_Rx_t *rx = &trace->rx[trace->line[i].rxIndex];
+        for (int j = 0; j < trace->line[i].rxCount; j++) {
+            if (rx[j].address == address && rx[j].timestamp.full == timestamp) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/* first line after `from` in which `address` received anything, -1 if none */
+int trace_next_rx(const Trace_t *trace, int from, uint16_t address, uint64_t *timestamp) {
+    for (int i = from + 1; i < trace->lineCount; i++) {
+        const Trace_Rx_t *rx = &trace->rx[trace->line[i].rxIndex];
+        for (int j = 0; j < trace->line[i].rxCount; j++) {
+            if (rx[j].address == address && rx[j].timestamp.full != 0) {
+                *timestamp = rx[j].timestamp.full;
+                return i;
+            }
+        }
+    }
+    *timestamp = NULL_TIMESTAMP;
+    return -1;
+}
+
+static int query_compare(const void *a, const void *b) {
+    const Trace_Query_t *x = a, *y = b;
+    if (x->local != y->local) {
+        return x->local < y->local ? -1 : 1;
+    }
+    if (x->neighbor != y->neighbor) {
+        return x->neighbor < y->neighbor ? -1 : 1;
+    }
+    if (x->systemTime != y->systemTime) {
+        return x->systemTime < y->systemTime ? -1 : 1;
+    }
+    return 0;
+}
+
+/* vicon.txt lines within [leftbound, rightbound] become query instants, rightbound 0 keeps everything */
+int schedule_load(Trace_Schedule_t *schedule, const char *filename, uint64_t leftbound, uint64_t rightbound) {
+    memset(schedule, 0, sizeof(Trace_Schedule_t));
+
+    FILE *fp = trace_fopen(filename);
+    if (!fp) {
+        perror("Failed to open query schedule");
+        return -1;
+    }
+
+    int capacity = 1024;
+    schedule->query = malloc(capacity * sizeof(Trace_Query_t));
+
+    char *text = NULL;
+    size_t text_size = 0;
+    while (getline(&text, &text_size, fp) > 0) {
+        unsigned int local, neighbor;
+        double truth;
+        unsigned long long system_time;
+        if (sscanf(text, "[local_%u <- neighbor_%u]: vicon dist = %lf, time = %llu", &local, &neighbor, &truth, &system_time) != 4) {
+            continue;
+        }
+        if (system_time < leftbound || (rightbound != 0 && system_time > rightbound)) {
+            continue;
+        }
+        if (schedule->queryCount == capacity) {
+            capacity *= 2;
+            schedule->query = realloc(schedule->query, capacity * sizeof(Trace_Query_t));
+        }
+        schedule->query[schedule->queryCount++] = (Trace_Query_t){
+            .local = (uint16_t)local,
+            .neighbor = (uint16_t)neighbor,
+            .systemTime = system_time,
+            .truth = truth
+        };
+    }
+
+    free(text);
+    fclose(fp);
+    qsort(schedule->query, schedule->queryCount, sizeof(Trace_Query_t), query_compare);
+    return schedule->queryCount;
+}
+
+void schedule_free(Trace_Schedule_t *schedule) {
+    free(schedule->query);
+    memset(schedule, 0, sizeof(Trace_Schedule_t));
+}
+
+/* first query of local <- neighbor at or after systemTime, queryCount if none */
+int schedule_lower_bound(const Trace_Schedule_t *schedule, uint16_t local, uint16_t neighbor, uint64_t systemTime) {
+    Trace_Query_t key = {.local = local, .neighbor = neighbor, .systemTime = systemTime};
+    int lo = 0, hi = schedule->queryCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (query_compare(&schedule->query[mid], &key) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
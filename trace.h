@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+#include "support.h"
+
+
+#define     TRACE_INDEX_MAGIC       "DTIX"
+#define     TRACE_INDEX_STRIDE      1024    // lines between two entries of the offset index <trace>.idx
+#define     TRACE_IMAGE_MAGIC       "DTIM"
+
+typedef struct {
+    uint16_t address;
+    dwTime_t timestamp;         // 0 when the receiver did not hear the message
+} Trace_Rx_t;
+
+typedef struct {
+    uint64_t systemTime;
+    uint16_t srcAddress;
+    uint16_t msgSeq;
+    uint16_t filter;
+    uint16_t rxCount;
+    uint32_t rxIndex;           // first receiver of the line in Trace_t.rx
+    dwTime_t txTimestamp;
+} Trace_Line_t;                 // one line of simulation_dep.csv
+
+typedef struct {
+    Trace_Line_t *line;
+    int lineCount;
+    Trace_Rx_t *rx;
+    int rxTotal;
+    int rxColumns;              // Rx columns declared by the header, 0 for a sparse trace
+    bool sparse;                // lines list only their receivers, after an rx_num column
+    int firstLine;              // lines of the file before line[0] when only a window is loaded
+    void *image;                // shared image the arrays point into, NULL when they are allocated
+    size_t imageSize;
+} Trace_t;                      // flight log kept in memory as flat arrays
+
+typedef struct {
+    char magic[4];              // TRACE_IMAGE_MAGIC
+    uint32_t headerSize;
+    uint32_t lineSize;          // sizeof(Trace_Line_t) and sizeof(Trace_Rx_t) of the writer
+    uint32_t rxSize;
+    int32_t lineCount;
+    int32_t rxTotal;
+    int32_t rxColumns;
+    int32_t firstLine;
+    uint8_t sparse;
+    uint8_t reserved[31];
+} Trace_Image_Header_t;         // shared-memory copy of a loaded Trace_t, followed by its line and rx arrays
+
+typedef struct {
+    char magic[4];              // TRACE_INDEX_MAGIC
+    uint32_t stride;
+    uint64_t traceSize;         // size and mtime of the trace the index was built from
+    uint64_t traceMtime;
+    uint64_t entryCount;
+} Trace_Index_Header_t;
+
+typedef struct {
+    uint64_t systemTime;
+    uint64_t offset;            // file offset of the line
+    uint64_t line;              // lines before it, header excluded
+} Trace_Index_Entry_t;          // every TRACE_INDEX_STRIDE-th line of a trace sorted by system_time
+
+typedef struct {
+    uint16_t local;
+    uint16_t neighbor;
+    uint64_t systemTime;
+    double truth;               // ground-truth distance at systemTime
+} Trace_Query_t;
+
+typedef struct {
+    Trace_Query_t *query;
+    int queryCount;
+} Trace_Schedule_t;             // query instants sorted by local, neighbor and systemTime
+
+
+int trace_count_rx(const char *header);
+bool trace_is_sparse(const char *header);
+int trace_parse_line(const char *text, Trace_Line_t *line, Trace_Rx_t *rx, int maxRx, bool sparse);
+FILE *trace_fopen(const char *filename);
+int trace_seek(FILE *fp, const char *filename, uint64_t systemTime, uint64_t *line);
+int trace_load(Trace_t *trace, const char *filename);
+int trace_load_window(Trace_t *trace, const char *filename, uint64_t from, uint64_t to);
+void trace_free(Trace_t *trace);
+int trace_share(const Trace_t *trace, const char *name);
+int trace_attach(Trace_t *trace, const char *name);
+int trace_find_rx(const Trace_t *trace, int from, uint16_t address, uint64_t timestamp);
+int trace_next_rx(const Trace_t *trace, int from, uint16_t address, uint64_t *timestamp);
+int schedule_load(Trace_Schedule_t *schedule, const char *filename, uint64_t leftbound, uint64_t rightbound);
+void schedule_free(Trace_Schedule_t *schedule);
+int schedule_lower_bound(const Trace_Schedule_t *schedule, uint16_t local, uint16_t neighbor, uint64_t systemTime);
+#endif